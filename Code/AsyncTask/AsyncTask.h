@@ -2,67 +2,435 @@
 #define ASYNC_TASK_H_
 
 #include <thread>
+#include <stdint.h>
 #include <list>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <utility>
 #include <unistd.h>
 
 #include "ThreadSafeList.h"
+#include "ThreadUtil.h"
+#include "TaskMetrics.h"
 
+#define ASYNC_TASK_GROW_WAIT_MS 10      // 弹性模式默认: 队列持续非空多久后扩容
+#define ASYNC_TASK_IDLE_MS      5000    // 弹性模式默认: worker空闲多久后退出
 
-template <typename T>
+
+// TList为任务队列, 默认CThreadSafeList; 生产者并发高时可使用CMpscQueue
+template <typename T, template <typename> class TList = CThreadSafeList>
 class CAsyncTask
 {
+    // 队列元素, enqueue_us只在开启统计时记录
+    struct Item {
+        T task;
+        int64_t enqueue_us;
+
+        Item() : enqueue_us(0) {}
+        Item(T && t, int64_t us) : task(std::move(t)), enqueue_us(us) {}
+    };
+
+    struct Worker {
+        std::thread thread;
+        CWorkerStats stats;
+
+        explicit Worker(size_t index) : stats(index) {}
+    };
+
 public:
-    CAsyncTask(void (*func)(T), const int max_size = 0, const int max_work = 1) : m_func(func) {
+    // opt设置线程名和CPU/NUMA绑定
+    CAsyncTask(void (*func)(T), const int max_size = 0, const int max_work = 1, const CThreadOptions & opt = CThreadOptions())
+        : m_func(func), m_batch_func(nullptr), m_entry(entry), m_opt(opt), m_next_index(0), m_max_batch(1), m_max_delay_ms(0) {
         m_max_size = max_size > 0 ? max_size : 0;
         m_max_work = max_work > 0 ? max_work : 1;
 
+        init_state();
+        std::unique_lock<std::mutex> lck(m_scale_mutex);
         for (size_t i = 0; i < m_max_work; ++i) {
-            m_threads.push_back(std::thread(entry, (void *)this));
+            spawn_locked();
+        }
+    }
+
+    // 批量模式: 每次唤醒一次加锁取走最多max_batch个任务交给func;
+    // max_delay_ms大于0时不足max_batch会继续等待, 最多等待max_delay_ms后提交
+    // 需要TList提供wait_and_drain(CThreadSafeList)
+    CAsyncTask(void (*func)(std::vector<T> &), const int max_size = 0, const int max_work = 1,
+               const int max_batch = 64, const int max_delay_ms = 0, const CThreadOptions & opt = CThreadOptions())
+        : m_func(nullptr), m_batch_func(func), m_entry(entry_batch), m_opt(opt), m_next_index(0) {
+        m_max_size = max_size > 0 ? max_size : 0;
+        m_max_work = max_work > 0 ? max_work : 1;
+        m_max_batch = max_batch > 0 ? max_batch : 1;
+        m_max_delay_ms = max_delay_ms > 0 ? max_delay_ms : 0;
+
+        init_state();
+        std::unique_lock<std::mutex> lck(m_scale_mutex);
+        for (size_t i = 0; i < m_max_work; ++i) {
+            spawn_locked();
         }
     }
 
     virtual ~CAsyncTask() {
         m_list.shutdown();
-        for (auto it = m_threads.begin(); it != m_threads.end(); ++it) {
-            it->join();
+
+        // 退出中的worker还会加锁登记, 不能持锁join; list::swap不移动节点, worker统计的地址不变
+        std::list<Worker> workers;
+        {
+            std::unique_lock<std::mutex> lck(m_scale_mutex);
+            workers.swap(m_workers);
         }
+        for (auto it = workers.begin(); it != workers.end(); ++it) {
+            it->thread.join();
+        }
+    }
+
+    int add_task(const T & task) {
+        return add_task(T(task));
     }
 
-    int add_task(T & task) {
-        if (m_max_size > 0 && m_list.size() >= m_max_size) {
+    // 移动入队, 支持unique_ptr等只能移动的任务类型; drain之后返回-1
+    int add_task(T && task) {
+        // 先计数再检查m_draining, 与drain中的先置位再读计数配对, drain不会漏掉任务
+        m_accepted.fetch_add(1, std::memory_order_seq_cst);
+        size_t depth = m_list.size();
+        if (m_draining.load(std::memory_order_seq_cst) || (m_max_size > 0 && depth >= m_max_size)) {
+            m_accepted.fetch_sub(1, std::memory_order_relaxed);
             return -1;
         }
-        m_list.push_back(task);
+
+        bool metrics = m_metrics.load(std::memory_order_relaxed);
+        m_list.emplace_back(std::move(task), metrics ? CWorkerStats::now_us() : 0);
+        if (metrics) {
+            update_max_depth(depth + 1);
+        }
+        check_grow(depth);
 
         return 0;
     }
 
+    // 停止接收新任务, 等待已接收的任务执行完; timeout_ms小于0时一直等待
+    // 全部完成返回true, 超时返回false(剩余任务仍会在析构时执行); worker保持运行直到析构
+    bool drain(const int timeout_ms = -1) {
+        m_draining.store(true, std::memory_order_seq_cst);
+
+        int64_t deadline = now_ms() + timeout_ms;
+        while (completed() < m_accepted.load(std::memory_order_seq_cst)) {
+            if (timeout_ms >= 0 && now_ms() >= deadline) {
+                return false;
+            }
+            usleep(1000);
+        }
+        return true;
+    }
+
+    // 开启后记录排队时间/执行时间直方图、最大队列长度和worker忙碌比例, 每个任务多两次取时间
+    // 重新开启时忙碌比例从开启时刻重新计算, 直方图仍然累计
+    void set_metrics(bool enable) {
+        std::unique_lock<std::mutex> lck(m_scale_mutex);
+        if (enable) {
+            for (auto it = m_workers.begin(); it != m_workers.end(); ++it) {
+                it->stats.busy_base_us.store(it->stats.busy_us.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+        }
+        m_metrics_start_us.store(CWorkerStats::now_us(), std::memory_order_relaxed);
+        m_metrics.store(enable, std::memory_order_relaxed);
+    }
+
+    CTaskMetrics metrics() {
+        CTaskMetrics out;
+        out.depth = m_list.size();
+        out.max_depth = m_max_depth.load(std::memory_order_relaxed);
+        out.accepted = m_accepted.load(std::memory_order_relaxed);
+
+        int64_t now = CWorkerStats::now_us();
+        int64_t since = m_metrics_start_us.load(std::memory_order_relaxed);
+        std::unique_lock<std::mutex> lck(m_scale_mutex);
+        out.done = m_retired_done;
+        out.wait.merge(m_retired_wait);
+        out.exec.merge(m_retired_exec);
+        for (auto it = m_workers.begin(); it != m_workers.end(); ++it) {
+            const CWorkerStats & stats = it->stats;
+            out.done += stats.done.load(std::memory_order_relaxed);
+            stats.wait.add_to(out.wait);
+            stats.exec.add_to(out.exec);
+            if (0 != stats.end_us.load(std::memory_order_relaxed)) {
+                continue;
+            }
+
+            int64_t elapsed = now - std::max(stats.start_us, since);
+            out.worker_index.push_back(stats.index);
+            // 开启时正在执行的任务整段计入, 截断到1
+            uint64_t busy = stats.busy_us.load(std::memory_order_relaxed) - stats.busy_base_us.load(std::memory_order_relaxed);
+            out.busy_ratio.push_back(elapsed > 0 ? std::min(1.0, (double)busy / elapsed) : 0);
+        }
+        return out;
+    }
+
+    // 弹性模式: worker数在[min_work, max_work]之间伸缩, 构造时的max_work为初始worker数
+    // 扩容: 队列长度达到grow_depth(0表示不按长度), 或队列持续非空超过grow_wait_ms时增加一个worker,
+    //       两次扩容至少间隔grow_wait_ms
+    // 缩容: worker空闲idle_ms后退出, 且距上次伸缩也需超过idle_ms, 即每idle_ms最多退出一个
+    // 应在提交任务前调用一次; 已阻塞等待的worker处理完下一个任务后才按新设置等待
+    void set_elastic(const int min_work, const int max_work, const int grow_depth = 0,
+                     const int grow_wait_ms = ASYNC_TASK_GROW_WAIT_MS, const int idle_ms = ASYNC_TASK_IDLE_MS) {
+        std::unique_lock<std::mutex> lck(m_scale_mutex);
+        m_min_work = min_work > 0 ? min_work : 1;
+        m_max_work = std::max((size_t)(max_work > 0 ? max_work : 1), m_min_work);
+        m_grow_depth = grow_depth > 0 ? grow_depth : 0;
+        m_grow_wait_ms = grow_wait_ms > 0 ? grow_wait_ms : 1;
+        m_idle_ms = idle_ms > 0 ? idle_ms : 1;
+        m_last_scale_ms.store(now_ms(), std::memory_order_relaxed);
+        m_elastic.store(true, std::memory_order_release);
+
+        while (m_live.load(std::memory_order_relaxed) < m_min_work) {
+            spawn_locked();
+        }
+    }
+
+    size_t size() {
+        return m_list.size();
+    }
+
+    // 当前worker数
+    size_t workers() {
+        return m_live.load(std::memory_order_relaxed);
+    }
+
 protected:
-    static void entry(void * pContext) {
-        ((CAsyncTask<T> *)pContext)->handle();
+    static void entry(void * pContext, CWorkerStats * stats) {
+        CAsyncTask * pTask = (CAsyncTask *)pContext;
+        CThreadUtil::apply(pTask->m_opt, stats->index);
+        pTask->handle(stats);
+    }
+
+    static void entry_batch(void * pContext, CWorkerStats * stats) {
+        CAsyncTask * pTask = (CAsyncTask *)pContext;
+        CThreadUtil::apply(pTask->m_opt, stats->index);
+        pTask->handle_batch(stats);
+    }
+
+    static int64_t now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 弹性模式下的空闲等待时间, 非弹性模式返回-1
+    int idle_wait_ms() {
+        return m_elastic.load(std::memory_order_acquire) ? m_idle_ms : -1;
+    }
+
+    void handle(CWorkerStats * stats) {
+        while(1) {
+            Item item;
+            int idle_ms = idle_wait_ms();
+            bool got = idle_ms < 0 ? m_list.pop_front(item, TYPE_BLOCK) : m_list.pop_front_for(item, idle_ms);
+            if (!got) {
+                if (m_list.is_stop() || (idle_ms >= 0 && try_retire(stats))) {
+                    return;
+                }
+                continue;
+            }
+
+            int64_t start_us = 0;
+            if (m_metrics.load(std::memory_order_relaxed)) {
+                start_us = CWorkerStats::now_us();
+                if (item.enqueue_us > 0) {
+                    stats->wait.record(start_us - item.enqueue_us);
+                }
+            }
+            (*m_func)(std::move(item.task));
+            finish(stats, start_us, 1);
+        }
     }
 
-    void handle() {
+    void handle_batch(CWorkerStats * stats) {
+        std::vector<Item> items;
+        std::vector<T> batch;
+        items.reserve(m_max_batch);
+        batch.reserve(m_max_batch);
+
         while(1) {
-            T task;
-            if (!m_list.pop_front(task, TYPE_BLOCK)) {
-                if (m_list.is_stop()) {
+            items.clear();
+            batch.clear();
+            int idle_ms = idle_wait_ms();
+            if (!m_list.wait_and_drain(items, m_max_batch, idle_ms)) {
+                // 停止或空闲超时
+                if (m_list.is_stop() || try_retire(stats)) {
                     return;
                 }
                 continue;
             }
-            (*m_func)(task);
+
+            // 凑批: 停止或超时后立即提交已取到的任务
+            if (m_max_delay_ms > 0 && items.size() < m_max_batch) {
+                std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_max_delay_ms);
+                while (items.size() < m_max_batch) {
+                    int remain_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+                    if (remain_ms <= 0 || !m_list.wait_and_drain(items, m_max_batch - items.size(), remain_ms)) {
+                        break;
+                    }
+                }
+            }
+
+            int64_t start_us = m_metrics.load(std::memory_order_relaxed) ? CWorkerStats::now_us() : 0;
+            for (size_t i = 0; i < items.size(); ++i) {
+                if (start_us > 0 && items[i].enqueue_us > 0) {
+                    stats->wait.record(start_us - items[i].enqueue_us);
+                }
+                batch.push_back(std::move(items[i].task));
+            }
+            (*m_batch_func)(batch);
+            finish(stats, start_us, items.size());
+        }
+    }
+
+    // 任务执行完后更新统计; start_us为0表示未开启统计
+    void finish(CWorkerStats * stats, int64_t start_us, size_t count) {
+        if (start_us > 0) {
+            int64_t cost = CWorkerStats::now_us() - start_us;
+            stats->exec.record(cost);
+            stats->busy_us.store(stats->busy_us.load(std::memory_order_relaxed) + cost, std::memory_order_relaxed);
+        }
+        stats->done.store(stats->done.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    // 所有worker(含已退出的)执行完的任务数
+    uint64_t completed() {
+        std::unique_lock<std::mutex> lck(m_scale_mutex);
+        uint64_t done = m_retired_done;
+        for (auto it = m_workers.begin(); it != m_workers.end(); ++it) {
+            done += it->stats.done.load(std::memory_order_acquire);
+        }
+        return done;
+    }
+
+    void update_max_depth(size_t depth) {
+        size_t cur = m_max_depth.load(std::memory_order_relaxed);
+        while (depth > cur && !m_max_depth.compare_exchange_weak(cur, depth, std::memory_order_relaxed)) {
+        }
+    }
+
+    void init_state() {
+        m_metrics.store(false, std::memory_order_relaxed);
+        m_draining.store(false, std::memory_order_relaxed);
+        m_accepted.store(0, std::memory_order_relaxed);
+        m_max_depth.store(0, std::memory_order_relaxed);
+        m_metrics_start_us.store(0, std::memory_order_relaxed);
+        m_retired_done = 0;
+
+        m_elastic.store(false, std::memory_order_relaxed);
+        m_live.store(0, std::memory_order_relaxed);
+        m_min_work = m_max_work;
+        m_grow_depth = 0;
+        m_grow_wait_ms = ASYNC_TASK_GROW_WAIT_MS;
+        m_idle_ms = ASYNC_TASK_IDLE_MS;
+        m_last_empty_ms.store(now_ms(), std::memory_order_relaxed);
+        m_last_scale_ms.store(now_ms(), std::memory_order_relaxed);
+    }
+
+    // 调用者持有m_scale_mutex; 顺带回收已退出的worker, 统计并入m_retired_*
+    void spawn_locked() {
+        for (auto it = m_workers.begin(); it != m_workers.end(); ) {
+            if (std::find(m_retired.begin(), m_retired.end(), it->thread.get_id()) != m_retired.end()) {
+                it->thread.join();
+                m_retired_done += it->stats.done.load(std::memory_order_relaxed);
+                it->stats.wait.add_to(m_retired_wait);
+                it->stats.exec.add_to(m_retired_exec);
+                it = m_workers.erase(it);
+            } else {
+                ++it;
+            }
         }
+        m_retired.clear();
+
+        m_workers.emplace_back(m_next_index++);
+        Worker & worker = m_workers.back();
+        worker.thread = std::thread(m_entry, (void *)this, &worker.stats);
+        m_live.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // depth为入队前的队列长度; 入队前为空说明消费跟得上, 重新开始计时
+    void check_grow(size_t depth) {
+        if (!m_elastic.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        int64_t now = now_ms();
+        if (0 == depth) {
+            m_last_empty_ms.store(now, std::memory_order_relaxed);
+            return;
+        }
+
+        bool deep = m_grow_depth > 0 && depth + 1 >= m_grow_depth;
+        bool slow = now - m_last_empty_ms.load(std::memory_order_relaxed) >= m_grow_wait_ms;
+        if ((!deep && !slow) || now - m_last_scale_ms.load(std::memory_order_relaxed) < m_grow_wait_ms) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lck(m_scale_mutex, std::defer_lock);
+        if (!lck.try_lock() || m_live.load(std::memory_order_relaxed) >= m_max_work || m_list.is_stop()) {
+            return;
+        }
+        spawn_locked();
+        m_last_scale_ms.store(now, std::memory_order_relaxed);
+    }
+
+    // 空闲超时的worker尝试退出, 成功后由下次扩容或析构join
+    bool try_retire(CWorkerStats * stats) {
+        int64_t now = now_ms();
+        if (now - m_last_scale_ms.load(std::memory_order_relaxed) < m_idle_ms) {
+            return false;
+        }
+
+        std::unique_lock<std::mutex> lck(m_scale_mutex);
+        if (m_live.load(std::memory_order_relaxed) <= m_min_work) {
+            return false;
+        }
+        m_live.fetch_sub(1, std::memory_order_relaxed);
+        m_last_scale_ms.store(now, std::memory_order_relaxed);
+        m_retired.push_back(std::this_thread::get_id());
+        stats->end_us.store(CWorkerStats::now_us(), std::memory_order_relaxed);
+        return true;
     }
 
 
 private:
     void (*m_func)(T);
+    void (*m_batch_func)(std::vector<T> &);
+    void (*m_entry)(void *, CWorkerStats *);    // 只在批量构造函数中引用entry_batch, 非批量模式不要求TList支持wait_and_drain
 
-    std::list<std::thread> m_threads;
-    CThreadSafeList<T> m_list;
+    CThreadOptions m_opt;
+    size_t m_next_index;    // 线程序号, 用于线程名和pin_each
+
+    std::list<Worker> m_workers;    // 由m_scale_mutex保护
+    TList<Item> m_list;
     size_t m_max_size;
     size_t m_max_work;
+    size_t m_max_batch;
+    int m_max_delay_ms;
+
+    // 弹性伸缩, 参数在m_elastic置位前写入
+    std::mutex m_scale_mutex;
+    std::vector<std::thread::id> m_retired;
+    std::atomic<bool> m_elastic;
+    std::atomic<size_t> m_live;
+    size_t m_min_work;
+    size_t m_grow_depth;
+    int m_grow_wait_ms;
+    int m_idle_ms;
+    std::atomic<int64_t> m_last_empty_ms;  // 最近一次提交时看到队列为空的时间
+    std::atomic<int64_t> m_last_scale_ms;  // 最近一次伸缩的时间
+
+    // 统计与drain
+    std::atomic<bool> m_metrics;
+    std::atomic<bool> m_draining;
+    std::atomic<uint64_t> m_accepted;
+    std::atomic<size_t> m_max_depth;
+    std::atomic<int64_t> m_metrics_start_us;
+    uint64_t m_retired_done;        // 已退出worker的统计, 由m_scale_mutex保护
+    CHistogram m_retired_wait;
+    CHistogram m_retired_exec;
 };
 
 #endif
@@ -0,0 +1,131 @@
+#ifndef CHASE_LEV_DEQUE_H_
+#define CHASE_LEV_DEQUE_H_
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+#define CHASE_LEV_INIT_SIZE     256     // 初始容量, 2的幂
+
+
+// Chase-Lev工作窃取双端队列(Lê等人的C11内存序版本), 元素为指针
+// 所有者线程在bottom端push/take(LIFO), 其他线程在top端steal(FIFO)
+// 扩容后旧数组仍可能被窃取者读取, 保留到析构时释放
+template <typename T>
+class CChaseLevDeque
+{
+    struct Array {
+        int64_t size;
+        int64_t mask;
+        std::atomic<T *> * slots;
+
+        explicit Array(int64_t n) : size(n), mask(n - 1), slots(new std::atomic<T *>[n]) {}
+        ~Array() { delete [] slots; }
+
+        T * get(int64_t i) const {
+            return slots[i & mask].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t i, T * x) {
+            slots[i & mask].store(x, std::memory_order_relaxed);
+        }
+    };
+
+public:
+    CChaseLevDeque() : m_top(0), m_bottom(0), m_array(new Array(CHASE_LEV_INIT_SIZE)) {
+        m_arrays.push_back(m_array.load(std::memory_order_relaxed));
+    }
+
+    ~CChaseLevDeque() {
+        for (size_t i = 0; i < m_arrays.size(); ++i) {
+            delete m_arrays[i];
+        }
+    }
+
+    CChaseLevDeque(const CChaseLevDeque &) = delete;
+    void operator=(const CChaseLevDeque &) = delete;
+
+public:
+    // 仅所有者线程调用
+    void push(T * x) {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_acquire);
+        Array * a = m_array.load(std::memory_order_relaxed);
+        if (b - t > a->size - 1) {
+            a = grow(a, b, t);
+        }
+
+        a->put(b, x);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // 仅所有者线程调用, 为空返回nullptr
+    T * take() {
+        int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        Array * a = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+
+        T * x = nullptr;
+        if (t <= b) {
+            x = a->get(b);
+            if (t == b) {
+                // 最后一个元素, 与窃取者竞争
+                if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    x = nullptr;
+                }
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+            }
+        } else {
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return x;
+    }
+
+    // 任意线程调用, 为空或竞争失败返回nullptr
+    T * steal() {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+
+        Array * a = m_array.load(std::memory_order_acquire);
+        T * x = a->get(t);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return x;
+    }
+
+    size_t size() const {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+        return b > t ? (size_t)(b - t) : 0;
+    }
+
+
+private:
+    Array * grow(Array * a, int64_t b, int64_t t) {
+        Array * bigger = new Array(a->size * 2);
+        for (int64_t i = t; i < b; ++i) {
+            bigger->put(i, a->get(i));
+        }
+        m_arrays.push_back(bigger);
+        m_array.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+
+private:
+    std::atomic<int64_t> m_top;
+    char m_pad[64];
+    std::atomic<int64_t> m_bottom;
+    std::atomic<Array *> m_array;
+    std::vector<Array *> m_arrays;      // 所有者线程维护
+};
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef CHUNK_LIST_H_
+#define CHUNK_LIST_H_
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#define CHUNK_LIST_BYTES        4096    // 每个chunk存放元素的字节数
+#define CHUNK_LIST_MAX_SPARE    4       // 默认缓存的空闲chunk个数
+
+
+// 分段存储的FIFO队列: 元素连续存放在固定大小的chunk中, chunk以单链表相连
+// 取空的chunk进入空闲缓存供后续push复用, 缓存满时放入待释放链表,
+// 由调用者在锁外通过release_garbage()/free_chunks()释放, 稳态下不再调用malloc/free
+template <typename T>
+class CChunkList
+{
+public:
+    static const size_t CHUNK_NODES = sizeof(T) * 8 >= CHUNK_LIST_BYTES ? 8 : CHUNK_LIST_BYTES / sizeof(T);
+
+    struct Chunk {
+        Chunk * next;
+        size_t begin;   // 第一个有效元素
+        size_t end;     // 最后一个有效元素之后
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type slots[CHUNK_NODES];
+
+        T * at(size_t i) {
+            return reinterpret_cast<T *>(&slots[i]);
+        }
+    };
+
+public:
+    explicit CChunkList(size_t max_spare = CHUNK_LIST_MAX_SPARE)
+        : m_head(nullptr), m_tail(nullptr), m_spare(nullptr), m_garbage(nullptr),
+        m_size(0), m_spare_count(0), m_max_spare(max_spare) {
+    }
+
+    ~CChunkList() {
+        while (!empty()) {
+            pop_front();
+        }
+        free_chunks(m_head);
+        free_chunks(m_spare);
+        free_chunks(m_garbage);
+    }
+
+    CChunkList(const CChunkList &) = delete;
+    void operator=(const CChunkList &) = delete;
+
+public:
+    bool empty() const {
+        return 0 == m_size;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    T & front() {
+        return *m_head->at(m_head->begin);
+    }
+
+    // 下一次push不需要分配新chunk
+    bool has_room() const {
+        return (m_tail && m_tail->end < CHUNK_NODES) || m_spare;
+    }
+
+    // 没有空间时仍会在此分配chunk, 调用者可先在锁外alloc_chunk()并add_spare()避免
+    template <typename... Args>
+    void emplace_back(Args &&... args) {
+        if (!m_tail || m_tail->end == CHUNK_NODES) {
+            Chunk * chunk = m_spare;
+            if (chunk) {
+                m_spare = chunk->next;
+                --m_spare_count;
+            } else {
+                chunk = alloc_chunk();
+            }
+
+            chunk->next = nullptr;
+            chunk->begin = chunk->end = 0;
+            if (m_tail) {
+                m_tail->next = chunk;
+            } else {
+                m_head = chunk;
+            }
+            m_tail = chunk;
+        }
+
+        new (m_tail->at(m_tail->end)) T(std::forward<Args>(args)...);
+        ++m_tail->end;
+        ++m_size;
+    }
+
+    void pop_front() {
+        m_head->at(m_head->begin)->~T();
+        ++m_head->begin;
+        --m_size;
+        skip_empty();
+    }
+
+    // 把全部元素(整条chunk链)转移到dst中, O(1); dst须为新构造的空队列
+    void steal_all(CChunkList & dst) {
+        skip_empty();
+        if (empty()) {
+            return;
+        }
+
+        dst.m_head = m_head;
+        dst.m_tail = m_tail;
+        dst.m_size = m_size;
+        m_head = m_tail = nullptr;
+        m_size = 0;
+    }
+
+    // 把src的整条chunk链接到队尾, O(1); src通常在锁外构造
+    void append(CChunkList & src) {
+        if (src.empty()) {
+            return;
+        }
+
+        if (empty()) {
+            while (m_head) {
+                Chunk * chunk = m_head;
+                m_head = chunk->next;
+                recycle(chunk);
+            }
+            m_head = src.m_head;
+        } else {
+            m_tail->next = src.m_head;
+        }
+        m_tail = src.m_tail;
+        m_size += src.m_size;
+
+        src.m_head = src.m_tail = nullptr;
+        src.m_size = 0;
+    }
+
+    // 放入一个预先分配的空chunk
+    void add_spare(Chunk * chunk) {
+        chunk->next = m_spare;
+        m_spare = chunk;
+        ++m_spare_count;
+    }
+
+    // 取出待释放的chunk链, 调用者在锁外free_chunks()
+    Chunk * release_garbage() {
+        Chunk * garbage = m_garbage;
+        m_garbage = nullptr;
+        return garbage;
+    }
+
+    static Chunk * alloc_chunk() {
+        return static_cast<Chunk *>(::operator new(sizeof(Chunk)));
+    }
+
+    static void free_chunks(Chunk * chunk) {
+        while (chunk) {
+            Chunk * next = chunk->next;
+            ::operator delete(chunk);
+            chunk = next;
+        }
+    }
+
+
+private:
+    // 跳过队头已取空的chunk; 只剩一个chunk时原地复位
+    void skip_empty() {
+        while (m_head && m_head->begin == m_head->end) {
+            if (!m_head->next) {
+                m_head->begin = m_head->end = 0;
+                break;
+            }
+
+            Chunk * chunk = m_head;
+            m_head = chunk->next;
+            recycle(chunk);
+        }
+    }
+
+    void recycle(Chunk * chunk) {
+        if (m_spare_count < m_max_spare) {
+            add_spare(chunk);
+        } else {
+            chunk->next = m_garbage;
+            m_garbage = chunk;
+        }
+    }
+
+
+private:
+    Chunk * m_head;
+    Chunk * m_tail;
+    Chunk * m_spare;
+    Chunk * m_garbage;
+    size_t m_size;
+    size_t m_spare_count;
+    size_t m_max_spare;
+};
+
+#endif
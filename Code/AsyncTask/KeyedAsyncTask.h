@@ -0,0 +1,253 @@
+#ifndef KEYED_ASYNC_TASK_H_
+#define KEYED_ASYNC_TASK_H_
+
+#include <stdint.h>
+#include <thread>
+#include <list>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <utility>
+
+#include "ThreadSafeList.h"
+#include "ThreadUtil.h"
+
+#define KEYED_SLOTS_PER_WORKER  64      // 每个worker默认的虚拟分区数
+#define KEYED_REBALANCE_EVERY   1024    // 分区每提交多少次尝试一次再平衡
+#define KEYED_REBALANCE_MOVES   4       // 每次再平衡最多迁移的分区数
+
+
+// 按key保序的异步任务: key哈希到虚拟分区, 每个分区同一时刻只属于一个worker, 同一key的任务按提交顺序执行,
+// 不同key并行. 分区没有待执行任务时才允许迁移到其他worker, 迁移不破坏顺序; 提交路径无全局锁
+template <typename T, typename Key = uint64_t, typename Hash = std::hash<Key> >
+class CKeyedAsyncTask
+{
+    static const uint32_t MIGRATING = 1u << 31;    // pending的最高位表示分区正在迁移
+
+    struct Entry {
+        uint32_t slot;
+        T task;
+    };
+
+    struct Slot {
+        std::atomic<uint32_t> pending;  // 已提交未执行完的任务数
+        std::atomic<int> owner;
+        std::atomic<uint32_t> hits;     // 上次再平衡以来的提交数
+        char pad[64 - 3 * sizeof(uint32_t)];
+    };
+
+public:
+    // max_size为单个worker队列的长度限制; slots为0时按worker数自动设置
+    CKeyedAsyncTask(void (*func)(T), const int max_size = 0, const int max_work = 1, const int slots = 0,
+                    const CThreadOptions & opt = CThreadOptions())
+        : m_func(func), m_opt(opt), m_rebalance(true) {
+        m_max_size = max_size > 0 ? max_size : 0;
+        m_max_work = max_work > 0 ? max_work : 1;
+
+        size_t count = 1;
+        size_t want = slots > 0 ? (size_t)slots : m_max_work * KEYED_SLOTS_PER_WORKER;
+        while (count < want) {
+            count <<= 1;
+        }
+        m_slot_mask = count - 1;
+        m_slots = new Slot[count];
+        for (size_t i = 0; i < count; ++i) {
+            m_slots[i].pending.store(0, std::memory_order_relaxed);
+            m_slots[i].owner.store((int)(i % m_max_work), std::memory_order_relaxed);
+            m_slots[i].hits.store(0, std::memory_order_relaxed);
+        }
+
+        for (size_t i = 0; i < m_max_work; ++i) {
+            m_lists.push_back(new CThreadSafeList<Entry>());
+        }
+        for (size_t i = 0; i < m_max_work; ++i) {
+            m_threads.push_back(std::thread(entry, (void *)this, (int)i));
+        }
+    }
+
+    virtual ~CKeyedAsyncTask() {
+        for (size_t i = 0; i < m_lists.size(); ++i) {
+            m_lists[i]->shutdown();
+        }
+        for (auto it = m_threads.begin(); it != m_threads.end(); ++it) {
+            it->join();
+        }
+        for (size_t i = 0; i < m_lists.size(); ++i) {
+            delete m_lists[i];
+        }
+        delete [] m_slots;
+    }
+
+    int add_task(const Key & key, const T & task) {
+        return add_task(key, T(task));
+    }
+
+    int add_task(const Key & key, T && task) {
+        uint32_t index = slot_of(key);
+        Slot & slot = m_slots[index];
+
+        // 先占住分区再读owner, 迁移中则等待迁移完成
+        uint32_t pending = slot.pending.fetch_add(1, std::memory_order_acq_rel);
+        while (pending & MIGRATING) {
+            std::this_thread::yield();
+            pending = slot.pending.load(std::memory_order_acquire);
+        }
+
+        int owner = slot.owner.load(std::memory_order_acquire);
+        CThreadSafeList<Entry> * list = m_lists[owner];
+        if (m_max_size > 0 && list->size() >= m_max_size) {
+            slot.pending.fetch_sub(1, std::memory_order_release);
+            return -1;
+        }
+
+        Entry e;
+        e.slot = index;
+        e.task = std::move(task);
+        list->push_back(std::move(e));
+
+        uint32_t hits = slot.hits.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (m_rebalance.load(std::memory_order_relaxed) && 0 == hits % KEYED_REBALANCE_EVERY) {
+            rebalance();
+        }
+        return 0;
+    }
+
+    void set_rebalance(bool enable) {
+        m_rebalance.store(enable, std::memory_order_relaxed);
+    }
+
+    // 把负载最高的worker上没有待执行任务的分区迁移到负载最低的worker, 返回迁移的分区数
+    // 负载 = 队列长度 + 上次再平衡以来的提交数; 可由调用者定期调用, 开启自动再平衡时也会在提交路径上触发
+    int rebalance() {
+        std::unique_lock<std::mutex> lck(m_rebalance_mutex, std::defer_lock);
+        if (!lck.try_lock() || m_max_work < 2) {
+            return 0;
+        }
+
+        size_t count = m_slot_mask + 1;
+        std::vector<uint64_t> load(m_max_work, 0);
+        std::vector<uint32_t> hits(count, 0);
+        for (size_t i = 0; i < m_max_work; ++i) {
+            load[i] = m_lists[i]->size();
+        }
+        for (size_t i = 0; i < count; ++i) {
+            hits[i] = m_slots[i].hits.exchange(0, std::memory_order_relaxed);
+            load[m_slots[i].owner.load(std::memory_order_relaxed)] += hits[i];
+        }
+
+        int moved = 0;
+        for (; moved < KEYED_REBALANCE_MOVES; ++moved) {
+            size_t hot = 0;
+            size_t cold = 0;
+            for (size_t i = 1; i < m_max_work; ++i) {
+                if (load[i] > load[hot]) {
+                    hot = i;
+                }
+                if (load[i] < load[cold]) {
+                    cold = i;
+                }
+            }
+
+            // 差距不到一半时不迁移, 避免来回抖动
+            uint64_t gap = load[hot] - load[cold];
+            if (hot == cold || gap * 2 < load[hot]) {
+                break;
+            }
+
+            // 选迁移后不会让cold变成新热点的最大分区
+            size_t best = count;
+            for (size_t i = 0; i < count; ++i) {
+                if ((size_t)m_slots[i].owner.load(std::memory_order_relaxed) != hot || 0 == hits[i] || hits[i] > gap / 2) {
+                    continue;
+                }
+                if (best == count || hits[i] > hits[best]) {
+                    if (0 == m_slots[i].pending.load(std::memory_order_relaxed)) {
+                        best = i;
+                    }
+                }
+            }
+            if (best == count || !migrate(best, (int)cold)) {
+                break;
+            }
+
+            load[hot] -= hits[best];
+            load[cold] += hits[best];
+            hits[best] = 0;
+        }
+
+        return moved;
+    }
+
+    // 所有worker队列中的任务数
+    size_t size() {
+        size_t total = 0;
+        for (size_t i = 0; i < m_lists.size(); ++i) {
+            total += m_lists[i]->size();
+        }
+        return total;
+    }
+
+    // key当前所在的worker, 用于观察分区分布
+    int worker_of(const Key & key) {
+        return m_slots[slot_of(key)].owner.load(std::memory_order_relaxed);
+    }
+
+protected:
+    static void entry(void * pContext, int index) {
+        CThreadUtil::apply(((CKeyedAsyncTask *)pContext)->m_opt, index);
+        ((CKeyedAsyncTask *)pContext)->handle(index);
+    }
+
+    void handle(int index) {
+        CThreadSafeList<Entry> * list = m_lists[index];
+        while(1) {
+            Entry e;
+            if (!list->pop_front(e, TYPE_BLOCK)) {
+                if (list->is_stop()) {
+                    return;
+                }
+                continue;
+            }
+            (*m_func)(std::move(e.task));
+            m_slots[e.slot].pending.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    uint32_t slot_of(const Key & key) {
+        uint64_t h = (uint64_t)m_hash(key) * 0x9E3779B97F4A7C15ull;
+        return (uint32_t)(h >> 32) & m_slot_mask;
+    }
+
+    // 只有pending为0时才能占住分区, 占住期间提交者等待, 改owner后释放
+    bool migrate(size_t index, int to) {
+        Slot & slot = m_slots[index];
+        uint32_t expect = 0;
+        if (!slot.pending.compare_exchange_strong(expect, MIGRATING, std::memory_order_acq_rel)) {
+            return false;
+        }
+
+        slot.owner.store(to, std::memory_order_release);
+        slot.pending.fetch_sub(MIGRATING, std::memory_order_release);
+        return true;
+    }
+
+
+private:
+    void (*m_func)(T);
+    Hash m_hash;
+    CThreadOptions m_opt;
+
+    std::list<std::thread> m_threads;
+    std::vector<CThreadSafeList<Entry> *> m_lists;
+    Slot * m_slots;
+    uint32_t m_slot_mask;
+
+    std::atomic<bool> m_rebalance;
+    std::mutex m_rebalance_mutex;
+
+    size_t m_max_size;
+    size_t m_max_work;
+};
+
+#endif
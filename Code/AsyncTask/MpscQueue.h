@@ -0,0 +1,218 @@
+#ifndef MPSC_QUEUE_H_
+#define MPSC_QUEUE_H_
+#include <limits.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "ThreadSafeList.h"     // TYPE_BLOCK / TYPE_NOT_BLOCK
+
+#define MPSC_SPIN_COUNT     128     // park前的自旋次数
+
+
+// 无锁多生产者队列(Vyukov intrusive MPSC), 接口与CThreadSafeList一致, 可作为CAsyncTask的队列
+// 生产者: 一次exchange + 一次store, 不加锁; 只有存在park的消费者时才futex唤醒
+// 消费者: 多个worker通过m_pop_mutex串行出队, 队列空时自旋后futex park
+template <typename T>
+class CMpscQueue
+{
+    struct NodeBase {
+        std::atomic<NodeBase *> next;
+
+        NodeBase() : next(nullptr) {}
+    };
+
+    struct Node : public NodeBase {
+        T value;
+
+        template <typename... Args>
+        explicit Node(Args &&... args) : value(std::forward<Args>(args)...) {}
+    };
+
+public:
+    CMpscQueue() : m_head(&m_stub), m_tail(&m_stub), m_size(0), m_seq(0), m_waiters(0), m_stop(false) {
+    }
+
+    ~CMpscQueue() {
+        T a;
+        while (try_pop(a)) {
+        }
+    }
+
+    CMpscQueue(const CMpscQueue &) = delete;
+    void operator=(const CMpscQueue &) = delete;
+
+public:
+    void shutdown() {
+        m_stop.store(true);
+        m_seq.fetch_add(1, std::memory_order_release);
+        futex_wake(INT_MAX);
+    }
+
+    bool is_stop() {
+        return m_stop.load(std::memory_order_relaxed);
+    }
+
+    void push_back(const T & a) {
+        emplace_back(a);
+    }
+
+    void push_back(T && a) {
+        emplace_back(std::move(a));
+    }
+
+    template <typename... Args>
+    void emplace_back(Args &&... args) {
+        Node * node = new Node(std::forward<Args>(args)...);
+
+        // 先计数再链接, size()不会因消费者先出队而下溢;
+        // 与消费者park前的m_waiters/m_size检查配对, 保证不丢唤醒
+        m_size.fetch_add(1, std::memory_order_seq_cst);
+        NodeBase * prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+
+        if (m_waiters.load(std::memory_order_seq_cst) > 0) {
+            m_seq.fetch_add(1, std::memory_order_release);
+            futex_wake(1);
+        }
+    }
+
+    bool pop_front(T & a, const int type = TYPE_BLOCK) {
+        if (type == TYPE_NOT_BLOCK) {
+            return getWithoutBlock(a);
+        }
+
+        return getWithBlock(a);
+    }
+
+    // 最多等待timeout_ms, 超时或停止返回false
+    bool pop_front_for(T & a, int timeout_ms) {
+        return getWithBlock(a, timeout_ms > 0 ? timeout_ms : 0);
+    }
+
+    size_t size() {
+        return m_size.load(std::memory_order_relaxed);
+    }
+
+
+protected:
+    bool getWithoutBlock(T & a) {
+        std::unique_lock<std::mutex> lck(m_pop_mutex, std::defer_lock);
+        if (!lck.try_lock()) {
+            return false;
+        }
+
+        return pop_locked(a);
+    }
+
+    // timeout_ms小于0时一直等待
+    bool getWithBlock(T & a, int timeout_ms = -1) {
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        int spin = 0;
+        while (true) {
+            if (try_pop(a)) {
+                return true;
+            }
+
+            if (m_stop.load()) {
+                return false;
+            }
+
+            // 生产者已计数但尚未链接完成时也会走到这里, 自旋等待即可
+            if (++spin < MPSC_SPIN_COUNT || m_size.load(std::memory_order_relaxed) > 0) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            spin = 0;
+            struct timespec ts;
+            struct timespec * timeout = NULL;
+            if (timeout_ms >= 0) {
+                int64_t remain_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+                if (remain_ns <= 0) {
+                    return false;
+                }
+                ts.tv_sec = remain_ns / 1000000000;
+                ts.tv_nsec = remain_ns % 1000000000;
+                timeout = &ts;
+            }
+
+            uint32_t seq = m_seq.load(std::memory_order_acquire);
+            m_waiters.fetch_add(1, std::memory_order_seq_cst);
+            if (0 == m_size.load(std::memory_order_seq_cst) && !m_stop.load()) {
+                syscall(SYS_futex, (uint32_t *)&m_seq, FUTEX_WAIT_PRIVATE, seq, timeout, NULL, 0);
+            }
+            m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_pop(T & a) {
+        std::unique_lock<std::mutex> lck(m_pop_mutex);
+        return pop_locked(a);
+    }
+
+    // 调用者持有m_pop_mutex, 即同一时刻只有一个消费者
+    bool pop_locked(T & a) {
+        NodeBase * tail = m_tail;
+        NodeBase * next = tail->next.load(std::memory_order_acquire);
+        if (tail == &m_stub) {
+            if (!next) {
+                return false;
+            }
+            m_tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (!next) {
+            if (tail != m_head.load(std::memory_order_acquire)) {
+                return false;   // 生产者正在链接
+            }
+
+            // tail是最后一个节点, 放回stub后才能取出tail
+            m_stub.next.store(nullptr, std::memory_order_relaxed);
+            NodeBase * prev = m_head.exchange(&m_stub, std::memory_order_acq_rel);
+            prev->next.store(&m_stub, std::memory_order_release);
+
+            next = tail->next.load(std::memory_order_acquire);
+            if (!next) {
+                return false;
+            }
+        }
+
+        m_tail = next;
+        Node * node = static_cast<Node *>(tail);
+        a = std::move(node->value);
+        delete node;
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void futex_wake(int count) {
+        syscall(SYS_futex, (uint32_t *)&m_seq, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+    }
+
+
+private:
+    // 生产者端与消费者端分开在不同cache line; 用填充而非alignas, 避免C++11下new对齐不足
+    std::atomic<NodeBase *> m_head;
+    char m_pad0[64];
+    NodeBase * m_tail;
+    NodeBase m_stub;
+    std::mutex m_pop_mutex;
+    char m_pad1[64];
+
+    std::atomic<size_t> m_size;
+    std::atomic<uint32_t> m_seq;        // futex word
+    std::atomic<int> m_waiters;
+    std::atomic<bool> m_stop;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef NODE_ASYNC_TASK_H_
+#define NODE_ASYNC_TASK_H_
+
+#include <sched.h>
+#include <vector>
+#include <utility>
+
+#include "AsyncTask.h"
+#include "ThreadUtil.h"
+
+
+// 按NUMA节点划分的线程池: 每个节点一个CAsyncTask子池, 子池的worker绑定在本节点的CPU上,
+// 任务默认放入提交线程所在节点的队列, 队列和任务数据不跨节点访问
+// 单节点机器上等价于一个CAsyncTask
+template <typename T, template <typename> class TList = CThreadSafeList>
+class CNodeAsyncTask
+{
+public:
+    // max_size和max_work均为每个节点的设置; opt.name为线程名前缀, 子池线程名为"name序号-节点内序号"
+    CNodeAsyncTask(void (*func)(T), const int max_size = 0, const int max_work = 1, const CThreadOptions & opt = CThreadOptions())
+        : m_cpu_node(CThreadUtil::cpu_node_map()) {
+        std::vector<int> nodes = CThreadUtil::nodes();
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            CThreadOptions node_opt(opt);
+            node_opt.node = nodes[i];
+            node_opt.cpus.clear();
+            if (!opt.name.empty()) {
+                node_opt.name = opt.name + std::to_string(nodes[i]);
+            }
+
+            if (nodes[i] >= (int)m_index.size()) {
+                m_index.resize(nodes[i] + 1, 0);
+            }
+            m_index[nodes[i]] = m_pools.size();
+            m_pools.push_back(new CAsyncTask<T, TList>(func, max_size, max_work, node_opt));
+        }
+    }
+
+    virtual ~CNodeAsyncTask() {
+        for (size_t i = 0; i < m_pools.size(); ++i) {
+            delete m_pools[i];
+        }
+    }
+
+    CNodeAsyncTask(const CNodeAsyncTask &) = delete;
+    void operator=(const CNodeAsyncTask &) = delete;
+
+    // 放入当前线程所在节点的子池
+    int add_task(const T & task) {
+        return pool(local_node())->add_task(task);
+    }
+
+    int add_task(T && task) {
+        return pool(local_node())->add_task(std::move(task));
+    }
+
+    // 指定节点, 如按数据所在节点提交
+    int add_task(int node, const T & task) {
+        return pool(node)->add_task(task);
+    }
+
+    int add_task(int node, T && task) {
+        return pool(node)->add_task(std::move(task));
+    }
+
+    size_t size() {
+        size_t total = 0;
+        for (size_t i = 0; i < m_pools.size(); ++i) {
+            total += m_pools[i]->size();
+        }
+        return total;
+    }
+
+    size_t node_count() {
+        return m_pools.size();
+    }
+
+    // 当前线程所在的节点
+    int local_node() {
+        int cpu = sched_getcpu();
+        if (cpu < 0 || cpu >= (int)m_cpu_node.size()) {
+            return 0;
+        }
+        return m_cpu_node[cpu];
+    }
+
+
+private:
+    CAsyncTask<T, TList> * pool(int node) {
+        if (node < 0 || node >= (int)m_index.size()) {
+            return m_pools[0];
+        }
+        return m_pools[m_index[node]];
+    }
+
+
+private:
+    std::vector<CAsyncTask<T, TList> *> m_pools;
+    std::vector<size_t> m_index;    // 节点号到m_pools下标
+    std::vector<int> m_cpu_node;    // CPU到节点号
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef PRIORITY_ASYNC_TASK_H_
+#define PRIORITY_ASYNC_TASK_H_
+
+#include <thread>
+#include <list>
+#include <vector>
+#include <utility>
+
+#include "PriorityLaneList.h"
+#include "ThreadUtil.h"
+
+
+// 多优先级异步任务: 任务按lane排队(lane 0优先级最高), 严格优先级或加权公平出队;
+// 任务可带超时, 排队超时的任务不再执行, 交给drop_func处理(如释放资源、返回失败);
+// 队列满时先丢弃各lane队头的过期任务, 再挤出低优先级lane中最早的任务, 都没有时才拒绝
+template <typename T>
+class CPriorityAsyncTask
+{
+public:
+    // max_size为所有lane的总长度限制; weights见CPriorityLaneList
+    CPriorityAsyncTask(void (*func)(T), const int max_size = 0, const int max_work = 1, const int lanes = 3,
+                       const int mode = LANE_STRICT, const std::vector<int> & weights = std::vector<int>(),
+                       const CThreadOptions & opt = CThreadOptions())
+        : m_func(func), m_drop_func(nullptr), m_opt(opt), m_list(lanes, mode, weights) {
+        m_max_size = max_size > 0 ? max_size : 0;
+        m_max_work = max_work > 0 ? max_work : 1;
+
+        for (size_t i = 0; i < m_max_work; ++i) {
+            m_threads.push_back(std::thread(entry, (void *)this, i));
+        }
+    }
+
+    virtual ~CPriorityAsyncTask() {
+        m_list.shutdown();
+        for (auto it = m_threads.begin(); it != m_threads.end(); ++it) {
+            it->join();
+        }
+    }
+
+    // 过期任务的处理函数, 在提交任务前设置; 不设置时直接析构
+    void set_drop_handler(void (*func)(T)) {
+        m_drop_func = func;
+    }
+
+    // timeout_ms大于0时, 排队超过timeout_ms的任务被丢弃
+    int add_task(size_t lane, const T & task, const int timeout_ms = 0) {
+        return add_task(lane, T(task), timeout_ms);
+    }
+
+    // 被清理或挤出的任务在提交线程中交给drop_func
+    int add_task(size_t lane, T && task, const int timeout_ms = 0) {
+        std::vector<T> dropped;
+        bool pushed = m_list.push_back(lane, std::move(task), timeout_ms, m_max_size, dropped);
+        drop_all(dropped);
+
+        return pushed ? 0 : -1;
+    }
+
+    size_t size() {
+        return m_list.size();
+    }
+
+    size_t size(size_t lane) {
+        return m_list.size(lane);
+    }
+
+    CLaneStats stats(size_t lane) {
+        return m_list.stats(lane);
+    }
+
+protected:
+    static void entry(void * pContext, size_t index) {
+        CThreadUtil::apply(((CPriorityAsyncTask *)pContext)->m_opt, index);
+        ((CPriorityAsyncTask *)pContext)->handle();
+    }
+
+    void handle() {
+        std::vector<T> dropped;
+        while(1) {
+            T task;
+            if (!m_list.pop_front(task, dropped)) {
+                // 只取到过期任务时处理完继续, 否则是停止
+                if (dropped.empty()) {
+                    return;
+                }
+                drop_all(dropped);
+                continue;
+            }
+
+            // 过期任务在锁外处理
+            drop_all(dropped);
+            (*m_func)(std::move(task));
+        }
+    }
+
+    void drop_all(std::vector<T> & dropped) {
+        for (size_t i = 0; i < dropped.size(); ++i) {
+            if (m_drop_func) {
+                (*m_drop_func)(std::move(dropped[i]));
+            }
+        }
+        dropped.clear();
+    }
+
+
+private:
+    void (*m_func)(T);
+    void (*m_drop_func)(T);
+    CThreadOptions m_opt;
+
+    std::list<std::thread> m_threads;
+    CPriorityLaneList<T> m_list;
+    size_t m_max_size;
+    size_t m_max_work;
+};
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef PRIORITY_LANE_LIST_H_
+#define PRIORITY_LANE_LIST_H_
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <utility>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+const int LANE_STRICT = 1;      // 严格优先级: 总是先取编号小的lane
+const int LANE_WEIGHTED = 2;    // 加权公平: 按权重平滑轮转, 低优先级lane不会饿死
+
+
+// lane统计, 等待时间为入队到出队(或丢弃)的时间
+struct CLaneStats {
+    size_t depth;           // 当前长度
+    uint64_t pushed;
+    uint64_t popped;
+    uint64_t dropped;       // 已过期或队列满时被更高优先级的任务挤出
+    uint64_t wait_us_total; // 已出队任务的等待时间之和
+    uint64_t wait_us_max;
+
+    CLaneStats() : depth(0), pushed(0), popped(0), dropped(0), wait_us_total(0), wait_us_max(0) {}
+
+    uint64_t wait_us_avg() const {
+        return popped > 0 ? wait_us_total / popped : 0;
+    }
+};
+
+
+// 多优先级队列, lane 0优先级最高; 任务可带截止时间, 已过期或被挤出的任务放入dropped由调用者处理
+template <typename T>
+class CPriorityLaneList
+{
+    struct Item {
+        T task;
+        int64_t enqueue_us;
+        int64_t deadline_us;    // 0表示不过期
+    };
+
+    struct Lane {
+        std::deque<Item> items;
+        int weight;
+        int current;            // 平滑加权轮转的当前权重
+        CLaneStats stats;
+    };
+
+public:
+    // weights为各lane权重, 仅LANE_WEIGHTED使用, 不足的lane权重为1
+    CPriorityLaneList(const int lanes, const int mode = LANE_STRICT, const std::vector<int> & weights = std::vector<int>())
+        : m_stop(false), m_mode(mode), m_size(0) {
+        m_lanes.resize(lanes > 0 ? lanes : 1);
+        for (size_t i = 0; i < m_lanes.size(); ++i) {
+            m_lanes[i].weight = (i < weights.size() && weights[i] > 0) ? weights[i] : 1;
+            m_lanes[i].current = 0;
+        }
+    }
+
+public:
+    void shutdown() {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        m_stop = true;
+        m_cond.notify_all();
+    }
+
+    bool is_stop() {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        return m_stop;
+    }
+
+    // timeout_ms大于0时任务在入队timeout_ms后过期; lane越界时放入最低优先级
+    // max_size大于0且已满时, 先清理各lane队头的过期任务, 仍然满则挤出比lane优先级低的最低lane中最早的任务,
+    // 清理和挤出的任务移入dropped; 没有可挤出的任务时返回false, task保持不变
+    bool push_back(size_t lane, T && task, const int timeout_ms, const size_t max_size, std::vector<T> & dropped) {
+        int64_t now = now_us();
+        if (lane >= m_lanes.size()) {
+            lane = m_lanes.size() - 1;
+        }
+
+        std::unique_lock<std::mutex> lck(m_mutex);
+        if (max_size > 0 && m_size >= max_size) {
+            purge_expired(now, dropped);
+            if (m_size >= max_size && !evict_lower(lane, dropped)) {
+                return false;
+            }
+        }
+
+        Lane & l = m_lanes[lane];
+        l.items.push_back(Item());
+        Item & item = l.items.back();
+        item.task = std::move(task);
+        item.enqueue_us = now;
+        item.deadline_us = timeout_ms > 0 ? now + (int64_t)timeout_ms * 1000 : 0;
+        ++l.stats.pushed;
+        ++m_size;
+        m_cond.notify_one();
+        return true;
+    }
+
+    // 阻塞取出一个未过期的任务, 途中遇到的过期任务移入dropped;
+    // 只取到过期任务时立即返回false让调用者处理dropped, 停止且为空时返回false且dropped为空
+    bool pop_front(T & a, std::vector<T> & dropped) {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        while (1) {
+            while (0 == m_size) {
+                if (!dropped.empty() || m_stop) {
+                    return false;
+                }
+                m_cond.wait(lck);
+            }
+
+            Lane & l = m_lanes[select()];
+            Item & item = l.items.front();
+            int64_t now = now_us();
+            uint64_t wait_us = (uint64_t)(now - item.enqueue_us);
+            bool expired = item.deadline_us > 0 && now > item.deadline_us;
+            if (expired) {
+                dropped.push_back(std::move(item.task));
+                ++l.stats.dropped;
+            } else {
+                a = std::move(item.task);
+                ++l.stats.popped;
+                l.stats.wait_us_total += wait_us;
+                if (wait_us > l.stats.wait_us_max) {
+                    l.stats.wait_us_max = wait_us;
+                }
+            }
+            l.items.pop_front();
+            --m_size;
+
+            if (!expired) {
+                return true;
+            }
+        }
+    }
+
+    size_t size() {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        return m_size;
+    }
+
+    size_t size(size_t lane) {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        return lane < m_lanes.size() ? m_lanes[lane].items.size() : 0;
+    }
+
+    size_t lanes() const {
+        return m_lanes.size();
+    }
+
+    CLaneStats stats(size_t lane) {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        if (lane >= m_lanes.size()) {
+            return CLaneStats();
+        }
+        CLaneStats s = m_lanes[lane].stats;
+        s.depth = m_lanes[lane].items.size();
+        return s;
+    }
+
+
+private:
+    static int64_t now_us() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 调用者持有m_mutex; 只从各lane队头清理, 遇到未过期的任务即停止,
+    // 持续过载时每次入队不必扫描整个队列(队列中间的过期任务在出队时丢弃)
+    void purge_expired(int64_t now, std::vector<T> & dropped) {
+        for (size_t i = 0; i < m_lanes.size(); ++i) {
+            Lane & l = m_lanes[i];
+            while (!l.items.empty() && l.items.front().deadline_us > 0 && now > l.items.front().deadline_us) {
+                dropped.push_back(std::move(l.items.front().task));
+                l.items.pop_front();
+                ++l.stats.dropped;
+                --m_size;
+            }
+        }
+    }
+
+    // 调用者持有m_mutex; 从优先级最低的非空lane(必须低于lane)挤出最早的任务
+    bool evict_lower(size_t lane, std::vector<T> & dropped) {
+        for (size_t i = m_lanes.size() - 1; i > lane; --i) {
+            Lane & l = m_lanes[i];
+            if (!l.items.empty()) {
+                dropped.push_back(std::move(l.items.front().task));
+                l.items.pop_front();
+                ++l.stats.dropped;
+                --m_size;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 调用者持有m_mutex且m_size大于0
+    size_t select() {
+        if (LANE_STRICT == m_mode) {
+            for (size_t i = 0; i < m_lanes.size(); ++i) {
+                if (!m_lanes[i].items.empty()) {
+                    return i;
+                }
+            }
+        }
+
+        // nginx平滑加权轮转, 只在非空lane之间分配
+        size_t best = m_lanes.size();
+        int total = 0;
+        for (size_t i = 0; i < m_lanes.size(); ++i) {
+            Lane & l = m_lanes[i];
+            if (l.items.empty()) {
+                continue;
+            }
+            l.current += l.weight;
+            total += l.weight;
+            if (best == m_lanes.size() || l.current > m_lanes[best].current) {
+                best = i;
+            }
+        }
+        m_lanes[best].current -= total;
+        return best;
+    }
+
+
+private:
+    bool m_stop;
+    int m_mode;
+    size_t m_size;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<Lane> m_lanes;
+};
+
+#endif
@@ -0,0 +1,518 @@
+#ifndef TASK_EXECUTOR_H_
+#define TASK_EXECUTOR_H_
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <cstddef>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "AsyncTask.h"
+
+#define SMALL_TASK_BUFFER   48      // 闭包不超过该大小时内联存放, 不分配堆内存
+
+
+// 类型擦除的void()可调用对象, 只能移动; 小闭包存放在内部缓冲区
+class CSmallTask
+{
+    struct Ops {
+        void (*invoke)(void * buf);
+        void (*move)(void * dst, void * src);   // 移动构造到dst并析构src
+        void (*destroy)(void * buf);
+    };
+
+    template <typename F>
+    struct InlineOps {
+        static void invoke(void * buf) {
+            (*static_cast<F *>(buf))();
+        }
+        static void move(void * dst, void * src) {
+            new (dst) F(std::move(*static_cast<F *>(src)));
+            static_cast<F *>(src)->~F();
+        }
+        static void destroy(void * buf) {
+            static_cast<F *>(buf)->~F();
+        }
+        static const Ops * ops() {
+            static const Ops s_ops = {invoke, move, destroy};
+            return &s_ops;
+        }
+    };
+
+    template <typename F>
+    struct HeapOps {
+        static void invoke(void * buf) {
+            (**static_cast<F **>(buf))();
+        }
+        static void move(void * dst, void * src) {
+            *static_cast<F **>(dst) = *static_cast<F **>(src);
+        }
+        static void destroy(void * buf) {
+            delete *static_cast<F **>(buf);
+        }
+        static const Ops * ops() {
+            static const Ops s_ops = {invoke, move, destroy};
+            return &s_ops;
+        }
+    };
+
+    typedef std::aligned_storage<SMALL_TASK_BUFFER, alignof(std::max_align_t)>::type Buffer;
+
+public:
+    CSmallTask() : m_ops(nullptr) {
+    }
+
+    template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, CSmallTask>::value>::type>
+    CSmallTask(F && f) : m_ops(nullptr) {
+        typedef typename std::decay<F>::type Func;
+        assign<Func>(std::forward<F>(f), std::integral_constant<bool, is_inline<Func>()>());
+    }
+
+    CSmallTask(CSmallTask && other) noexcept : m_ops(other.m_ops) {
+        if (m_ops) {
+            m_ops->move(&m_buf, &other.m_buf);
+            other.m_ops = nullptr;
+        }
+    }
+
+    CSmallTask & operator=(CSmallTask && other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.m_ops) {
+                other.m_ops->move(&m_buf, &other.m_buf);
+                m_ops = other.m_ops;
+                other.m_ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    CSmallTask(const CSmallTask &) = delete;
+    CSmallTask & operator=(const CSmallTask &) = delete;
+
+    ~CSmallTask() {
+        reset();
+    }
+
+    void operator()() {
+        m_ops->invoke(&m_buf);
+    }
+
+    explicit operator bool() const {
+        return m_ops != nullptr;
+    }
+
+    void reset() {
+        if (m_ops) {
+            m_ops->destroy(&m_buf);
+            m_ops = nullptr;
+        }
+    }
+
+    template <typename Func>
+    static constexpr bool is_inline() {
+        return sizeof(Func) <= sizeof(Buffer) && alignof(Func) <= alignof(Buffer)
+            && std::is_nothrow_move_constructible<Func>::value;
+    }
+
+private:
+    template <typename Func, typename F>
+    void assign(F && f, std::true_type) {
+        new (&m_buf) Func(std::forward<F>(f));
+        m_ops = InlineOps<Func>::ops();
+    }
+
+    template <typename Func, typename F>
+    void assign(F && f, std::false_type) {
+        *reinterpret_cast<Func **>(&m_buf) = new Func(std::forward<F>(f));
+        m_ops = HeapOps<Func>::ops();
+    }
+
+    Buffer m_buf;
+    const Ops * m_ops;
+};
+
+
+// future/promise共享状态: 侵入式引用计数, 结果就绪用futex等待, 不使用mutex/condition_variable
+template <typename R>
+class CTaskState
+{
+    enum {
+        STATE_EMPTY = 0,
+        STATE_READY = 1,
+        STATE_WAITING = 2,  // 未就绪且有线程等待
+    };
+
+public:
+    CTaskState() : m_refs(1), m_state(STATE_EMPTY), m_has_value(false) {
+    }
+
+    ~CTaskState() {
+        if (m_has_value) {
+            value_ptr()->~R();
+        }
+    }
+
+    void add_ref() {
+        m_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release() {
+        if (1 == m_refs.fetch_sub(1, std::memory_order_acq_rel)) {
+            delete this;
+        }
+    }
+
+    bool is_ready() const {
+        return STATE_READY == m_state.load(std::memory_order_acquire);
+    }
+
+    template <typename... Args>
+    void set_value(Args &&... args) {
+        new (value_ptr()) R(std::forward<Args>(args)...);
+        m_has_value = true;
+        notify();
+    }
+
+    void set_exception(std::exception_ptr error) {
+        m_error = error;
+        notify();
+    }
+
+    // 超时返回false; timeout_ms小于0时一直等待
+    bool wait(int timeout_ms = -1) {
+        int64_t deadline_ns = timeout_ms < 0 ? 0 : now_ns() + (int64_t)timeout_ms * 1000000;
+        uint32_t state = m_state.load(std::memory_order_acquire);
+        while (STATE_READY != state) {
+            if (STATE_EMPTY == state
+                && !m_state.compare_exchange_weak(state, STATE_WAITING, std::memory_order_acquire)) {
+                continue;
+            }
+
+            struct timespec ts;
+            if (timeout_ms >= 0) {
+                int64_t remain_ns = deadline_ns - now_ns();
+                if (remain_ns <= 0) {
+                    return false;
+                }
+                ts.tv_sec = remain_ns / 1000000000;
+                ts.tv_nsec = remain_ns % 1000000000;
+            }
+            syscall(SYS_futex, (uint32_t *)&m_state, FUTEX_WAIT_PRIVATE, STATE_WAITING, timeout_ms < 0 ? NULL : &ts, NULL, 0);
+            state = m_state.load(std::memory_order_acquire);
+        }
+        return true;
+    }
+
+    // 调用前需wait()返回true
+    R get() {
+        if (m_error) {
+            std::rethrow_exception(m_error);
+        }
+        return std::move(*value_ptr());
+    }
+
+private:
+    static int64_t now_ns() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+
+    R * value_ptr() {
+        return reinterpret_cast<R *>(&m_value);
+    }
+
+    void notify() {
+        if (STATE_WAITING == m_state.exchange(STATE_READY, std::memory_order_release)) {
+            syscall(SYS_futex, (uint32_t *)&m_state, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+        }
+    }
+
+    std::atomic<int> m_refs;
+    std::atomic<uint32_t> m_state;
+    bool m_has_value;
+    typename std::aligned_storage<sizeof(R), alignof(R)>::type m_value;
+    std::exception_ptr m_error;
+};
+
+// void结果用空结构体占位
+struct CTaskVoid {};
+
+template <typename R>
+struct CTaskStateType {
+    typedef CTaskState<R> type;
+};
+
+template <>
+struct CTaskStateType<void> {
+    typedef CTaskState<CTaskVoid> type;
+};
+
+
+template <typename R>
+class CTaskFuture
+{
+    typedef typename CTaskStateType<R>::type State;
+
+public:
+    CTaskFuture() : m_state(nullptr) {
+    }
+
+    explicit CTaskFuture(State * state) : m_state(state) {
+        m_state->add_ref();
+    }
+
+    CTaskFuture(CTaskFuture && other) noexcept : m_state(other.m_state) {
+        other.m_state = nullptr;
+    }
+
+    CTaskFuture & operator=(CTaskFuture && other) {
+        if (this != &other) {
+            if (m_state) {
+                m_state->release();
+            }
+            m_state = other.m_state;
+            other.m_state = nullptr;
+        }
+        return *this;
+    }
+
+    CTaskFuture(const CTaskFuture &) = delete;
+    CTaskFuture & operator=(const CTaskFuture &) = delete;
+
+    ~CTaskFuture() {
+        if (m_state) {
+            m_state->release();
+        }
+    }
+
+    bool valid() const {
+        return m_state != nullptr;
+    }
+
+    bool is_ready() const {
+        return m_state->is_ready();
+    }
+
+    void wait() {
+        m_state->wait();
+    }
+
+    // 超时返回false
+    bool wait_for(int timeout_ms) {
+        return m_state->wait(timeout_ms);
+    }
+
+    // 阻塞直到结果就绪, 任务抛出的异常在此重新抛出; 只能调用一次
+    R get() {
+        m_state->wait();
+        State * state = m_state;
+        m_state = nullptr;
+
+        struct Releaser {
+            State * state;
+            ~Releaser() { state->release(); }
+        } releaser = {state};
+        return (R)state->get();
+    }
+
+private:
+    template <template <typename> class TList>
+    friend class CTaskExecutor;
+
+    State * m_state;
+};
+
+
+template <typename R>
+class CTaskPromise
+{
+    typedef typename CTaskStateType<R>::type State;
+
+public:
+    CTaskPromise() : m_state(new State()), m_satisfied(false) {
+    }
+
+    CTaskPromise(CTaskPromise && other) noexcept : m_state(other.m_state), m_satisfied(other.m_satisfied) {
+        other.m_state = nullptr;
+    }
+
+    CTaskPromise(const CTaskPromise &) = delete;
+    CTaskPromise & operator=(const CTaskPromise &) = delete;
+    CTaskPromise & operator=(CTaskPromise &&) = delete;
+
+    // 未设置结果就析构时, future得到broken_promise异常
+    ~CTaskPromise() {
+        if (m_state) {
+            if (!m_satisfied && !m_state->is_ready()) {
+                m_state->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+            }
+            m_state->release();
+        }
+    }
+
+    CTaskFuture<R> get_future() {
+        return CTaskFuture<R>(m_state);
+    }
+
+    template <typename... Args>
+    void set_value(Args &&... args) {
+        m_state->set_value(std::forward<Args>(args)...);
+        m_satisfied = true;
+    }
+
+    void set_exception(std::exception_ptr error) {
+        m_state->set_exception(error);
+        m_satisfied = true;
+    }
+
+private:
+    State * m_state;
+    bool m_satisfied;
+};
+
+
+// C++11没有std::index_sequence
+template <size_t... I>
+struct CIndexSeq {};
+
+template <size_t N, size_t... I>
+struct CMakeIndexSeq : CMakeIndexSeq<N - 1, N - 1, I...> {};
+
+template <size_t... I>
+struct CMakeIndexSeq<0, I...> {
+    typedef CIndexSeq<I...> type;
+};
+
+
+// 函数及参数打包成的无参调用, 参数按值保存, 调用时移动给函数
+template <typename F, typename... Args>
+class CBoundCall
+{
+    typedef std::tuple<typename std::decay<Args>::type...> ArgTuple;
+    typedef typename CMakeIndexSeq<sizeof...(Args)>::type Indexes;
+
+public:
+    typedef typename std::result_of<typename std::decay<F>::type(typename std::decay<Args>::type...)>::type Result;
+
+    template <typename Fn, typename... As>
+    explicit CBoundCall(Fn && func, As &&... args)
+        : m_func(std::forward<Fn>(func)), m_args(std::forward<As>(args)...) {
+    }
+
+    Result operator()() {
+        return call(Indexes());
+    }
+
+private:
+    template <size_t... I>
+    Result call(CIndexSeq<I...>) {
+        return m_func(std::move(std::get<I>(m_args))...);
+    }
+
+    typename std::decay<F>::type m_func;
+    ArgTuple m_args;
+};
+
+
+// 执行结果或异常写入promise
+template <typename Call>
+class CPromiseTask
+{
+    typedef typename Call::Result R;
+
+public:
+    CPromiseTask(Call && call, CTaskPromise<R> && promise)
+        : m_call(std::move(call)), m_promise(std::move(promise)) {
+    }
+
+    void operator()() {
+        try {
+            invoke(std::is_void<R>());
+        } catch (...) {
+            m_promise.set_exception(std::current_exception());
+        }
+    }
+
+private:
+    void invoke(std::true_type) {
+        m_call();
+        m_promise.set_value();
+    }
+
+    void invoke(std::false_type) {
+        m_promise.set_value(m_call());
+    }
+
+    Call m_call;
+    CTaskPromise<R> m_promise;
+};
+
+
+// 通用任务执行器: 同一组线程执行任意可调用对象, 不同类型的任务不必各建线程池
+// submit返回CTaskFuture; post不需要结果, 不分配共享状态
+template <template <typename> class TList = CThreadSafeList>
+class CTaskExecutor
+{
+public:
+    explicit CTaskExecutor(const int max_size = 0, const int max_work = 1, const CThreadOptions & opt = CThreadOptions())
+        : m_pool(run, max_size, max_work, opt) {
+    }
+
+    // 队列满时future得到runtime_error
+    template <typename F, typename... Args>
+    CTaskFuture<typename CBoundCall<F, Args...>::Result> submit(F && func, Args &&... args) {
+        typedef CBoundCall<F, Args...> Call;
+        typedef typename Call::Result R;
+
+        CTaskPromise<R> promise;
+        CTaskFuture<R> future = promise.get_future();
+        CSmallTask task(CPromiseTask<Call>(Call(std::forward<F>(func), std::forward<Args>(args)...), std::move(promise)));
+
+        if (m_pool.add_task(std::move(task)) != 0) {
+            // 先设置异常, task析构时promise不再设置broken_promise
+            future.m_state->set_exception(std::make_exception_ptr(std::runtime_error("task queue full")));
+        }
+        return future;
+    }
+
+    // 队列满时返回-1; 任务抛出的异常被记录后丢弃
+    template <typename F, typename... Args>
+    int post(F && func, Args &&... args) {
+        return m_pool.add_task(CSmallTask(CBoundCall<F, Args...>(std::forward<F>(func), std::forward<Args>(args)...)));
+    }
+
+    size_t size() {
+        return m_pool.size();
+    }
+
+private:
+    // submit的异常已存入future; post的任务抛出异常时记录后丢弃, 不让异常逃出worker导致std::terminate
+    static void run(CSmallTask task) {
+        try {
+            task();
+        } catch (const std::exception & e) {
+            printf("CTaskExecutor post task threw: %s\n", e.what());
+        } catch (...) {
+            printf("CTaskExecutor post task threw unknown exception\n");
+        }
+    }
+
+    CAsyncTask<CSmallTask, TList> m_pool;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef TASK_METRICS_H_
+#define TASK_METRICS_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+#include <chrono>
+
+#define TASK_HIST_BUCKETS   32  // 第i个桶为[2^(i-1), 2^i)us, 桶0为小于1us, 最后一个桶包含更大的值
+
+
+// 直方图快照, 可合并多个worker的数据
+struct CHistogram {
+    uint64_t buckets[TASK_HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+
+    CHistogram() : count(0), sum_us(0), max_us(0) {
+        for (int i = 0; i < TASK_HIST_BUCKETS; ++i) {
+            buckets[i] = 0;
+        }
+    }
+
+    void merge(const CHistogram & other) {
+        for (int i = 0; i < TASK_HIST_BUCKETS; ++i) {
+            buckets[i] += other.buckets[i];
+        }
+        count += other.count;
+        sum_us += other.sum_us;
+        if (other.max_us > max_us) {
+            max_us = other.max_us;
+        }
+    }
+
+    uint64_t avg_us() const {
+        return count > 0 ? sum_us / count : 0;
+    }
+
+    // 分位数(0~1), 返回所在桶的上界, 不超过max_us
+    uint64_t percentile(double p) const {
+        uint64_t target = (uint64_t)(p * count);
+        uint64_t seen = 0;
+        for (int i = 0; i < TASK_HIST_BUCKETS; ++i) {
+            seen += buckets[i];
+            if (seen > target || (seen == count && seen > 0)) {
+                uint64_t upper = (i == TASK_HIST_BUCKETS - 1) ? max_us : ((uint64_t)1 << i);
+                return upper < max_us ? upper : max_us;
+            }
+        }
+        return 0;
+    }
+};
+
+
+// log2分桶的延迟直方图, 只允许一个线程写, 其他线程可随时读取快照
+class CLatencyHistogram
+{
+public:
+    CLatencyHistogram() : m_count(0), m_sum_us(0), m_max_us(0) {
+        for (int i = 0; i < TASK_HIST_BUCKETS; ++i) {
+            m_buckets[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // 单写者, 用load+store代替原子加
+    void record(uint64_t us) {
+        int index = 0;
+        while (index < TASK_HIST_BUCKETS - 1 && us >= ((uint64_t)1 << index)) {
+            ++index;
+        }
+        inc(m_buckets[index], 1);
+        inc(m_count, 1);
+        inc(m_sum_us, us);
+        if (us > m_max_us.load(std::memory_order_relaxed)) {
+            m_max_us.store(us, std::memory_order_relaxed);
+        }
+    }
+
+    void add_to(CHistogram & out) const {
+        CHistogram h;
+        for (int i = 0; i < TASK_HIST_BUCKETS; ++i) {
+            h.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        }
+        h.count = m_count.load(std::memory_order_relaxed);
+        h.sum_us = m_sum_us.load(std::memory_order_relaxed);
+        h.max_us = m_max_us.load(std::memory_order_relaxed);
+        out.merge(h);
+    }
+
+
+private:
+    static void inc(std::atomic<uint64_t> & value, uint64_t n) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+
+private:
+    std::atomic<uint64_t> m_buckets[TASK_HIST_BUCKETS];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum_us;
+    std::atomic<uint64_t> m_max_us;
+};
+
+
+// 单个worker的统计, 由worker自己写
+struct CWorkerStats {
+    size_t index;
+    int64_t start_us;
+    std::atomic<int64_t> end_us;        // 0表示仍在运行
+    std::atomic<uint64_t> done;         // 已执行完的任务数, 不受metrics开关影响
+    std::atomic<uint64_t> busy_us;      // 执行任务的时间, 累计值
+    std::atomic<uint64_t> busy_base_us; // 最近一次开启统计时的busy_us, 忙碌比例只计算其后的部分
+    CLatencyHistogram wait;             // 入队到开始执行
+    CLatencyHistogram exec;             // 执行时间, 批量模式为每批的执行时间
+
+    explicit CWorkerStats(size_t i) : index(i), start_us(now_us()), end_us(0), done(0), busy_us(0), busy_base_us(0) {}
+
+    static int64_t now_us() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+
+// CAsyncTask::metrics()返回的快照
+struct CTaskMetrics {
+    size_t depth;                   // 当前队列长度
+    size_t max_depth;               // 开启统计以来的最大队列长度
+    uint64_t accepted;              // 已接受的任务数
+    uint64_t done;                  // 已执行完的任务数
+    CHistogram wait;
+    CHistogram exec;
+    std::vector<size_t> worker_index;
+    std::vector<double> busy_ratio; // 与worker_index对应, 运行中worker自最近一次开启统计以来的忙碌时间占比
+                                    // wait/exec直方图和done为构造以来的累计值, 关闭再开启不清零
+
+    CTaskMetrics() : depth(0), max_depth(0), accepted(0), done(0) {}
+};
+
+#endif
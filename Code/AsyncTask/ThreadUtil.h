@@ -0,0 +1,155 @@
+#ifndef THREAD_UTIL_H_
+#define THREAD_UTIL_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <vector>
+
+#define THREAD_NODE_PATH    "/sys/devices/system/node"
+
+
+// 线程池的线程选项: 线程名, 绑定的CPU集合或NUMA节点
+struct CThreadOptions {
+    std::string name;       // 线程名前缀, 实际为"name-序号", 超过15字节截断
+    std::vector<int> cpus;  // 绑定的CPU, 为空时看node
+    int node;               // 绑定到该NUMA节点的所有CPU, -1不绑定
+    bool pin_each;          // true时每个线程只绑一个CPU, 按序号轮流分配
+
+    CThreadOptions(const std::string & thread_name = "", const int numa_node = -1)
+        : name(thread_name), node(numa_node), pin_each(false) {}
+};
+
+
+class CThreadUtil
+{
+public:
+    // 设置当前线程名, 在top -H / perf中可见
+    static bool set_name(const std::string & name) {
+        if (name.empty()) {
+            return false;
+        }
+        return 0 == pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+    }
+
+    // 当前线程绑定到cpus
+    static bool set_affinity(const std::vector<int> & cpus) {
+        if (cpus.empty()) {
+            return false;
+        }
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t i = 0; i < cpus.size(); ++i) {
+            if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE) {
+                CPU_SET(cpus[i], &set);
+            }
+        }
+        return 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    // 按选项设置第index个线程, 在线程入口处调用
+    static void apply(const CThreadOptions & opt, size_t index) {
+        if (!opt.name.empty()) {
+            set_name(opt.name + "-" + std::to_string(index));
+        }
+
+        std::vector<int> cpus = opt.cpus;
+        if (cpus.empty() && opt.node >= 0) {
+            cpus = node_cpus(opt.node);
+        }
+        if (cpus.empty()) {
+            return;
+        }
+
+        if (opt.pin_each) {
+            cpus = std::vector<int>(1, cpus[index % cpus.size()]);
+        }
+        if (!set_affinity(cpus)) {
+            fprintf(stderr, "set thread affinity failed, name:%s index:%lu\n", opt.name.c_str(), index);
+        }
+    }
+
+    // 解析"0-3,8,10-11"格式的列表
+    static std::vector<int> parse_list(const std::string & str) {
+        std::vector<int> out;
+        const char * p = str.c_str();
+        while (*p) {
+            char * end = NULL;
+            long first = strtol(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+
+            long last = first;
+            p = end;
+            if ('-' == *p) {
+                last = strtol(p + 1, &end, 10);
+                p = end;
+            }
+            for (long i = first; i <= last; ++i) {
+                out.push_back((int)i);
+            }
+
+            while (*p && (',' == *p || '\n' == *p || ' ' == *p)) {
+                ++p;
+            }
+        }
+        return out;
+    }
+
+    // 在线的NUMA节点, 不支持NUMA时返回{0}
+    static std::vector<int> nodes() {
+        std::vector<int> out = parse_list(read_file(THREAD_NODE_PATH "/online"));
+        if (out.empty()) {
+            out.push_back(0);
+        }
+        return out;
+    }
+
+    // 节点上的CPU; 读取失败时节点0返回所有在线CPU
+    static std::vector<int> node_cpus(int node) {
+        std::vector<int> out = parse_list(read_file(THREAD_NODE_PATH "/node" + std::to_string(node) + "/cpulist"));
+        if (out.empty() && 0 == node) {
+            out = parse_list(read_file("/sys/devices/system/cpu/online"));
+        }
+        return out;
+    }
+
+    // CPU到NUMA节点的映射, 下标为CPU编号; 用于按sched_getcpu()选择本节点
+    static std::vector<int> cpu_node_map() {
+        std::vector<int> out;
+        std::vector<int> all = nodes();
+        for (size_t i = 0; i < all.size(); ++i) {
+            std::vector<int> cpus = node_cpus(all[i]);
+            for (size_t j = 0; j < cpus.size(); ++j) {
+                if (cpus[j] >= (int)out.size()) {
+                    out.resize(cpus[j] + 1, 0);
+                }
+                out[cpus[j]] = all[i];
+            }
+        }
+        return out;
+    }
+
+
+private:
+    static std::string read_file(const std::string & path) {
+        std::string out;
+        FILE * fp = fopen(path.c_str(), "r");
+        if (!fp) {
+            return out;
+        }
+
+        char buf[256];
+        size_t n = 0;
+        while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+            out.append(buf, n);
+        }
+        fclose(fp);
+        return out;
+    }
+};
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef WORK_STEALING_TASK_H_
+#define WORK_STEALING_TASK_H_
+
+#include <stdint.h>
+#include <thread>
+#include <list>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+
+#include "ChaseLevDeque.h"
+#include "ThreadUtil.h"
+
+#define WORK_STEALING_INJECT_BATCH  32  // 从全局队列一次取走的最大任务数
+
+
+// 工作窃取线程池, 接口与CAsyncTask一致
+// 每个worker有自己的Chase-Lev双端队列; worker内(如处理函数中拆分子任务)调用add_task放入本地队列,
+// 其他线程调用放入全局注入队列; 本地队列为空时先取全局队列, 再随机窃取其他worker
+template <typename T>
+class CWorkStealingTask
+{
+    struct Current {
+        CWorkStealingTask * pool;
+        int index;
+    };
+
+public:
+    CWorkStealingTask(void (*func)(T), const int max_size = 0, const int max_work = 1, const CThreadOptions & opt = CThreadOptions())
+        : m_func(func), m_opt(opt), m_pending(0), m_sleepers(0), m_stop(false) {
+        m_max_size = max_size > 0 ? max_size : 0;
+        m_max_work = max_work > 0 ? max_work : 1;
+
+        for (size_t i = 0; i < m_max_work; ++i) {
+            m_deques.push_back(new CChaseLevDeque<T>());
+        }
+        for (size_t i = 0; i < m_max_work; ++i) {
+            m_threads.push_back(std::thread(entry, (void *)this, (int)i));
+        }
+    }
+
+    virtual ~CWorkStealingTask() {
+        {
+            std::unique_lock<std::mutex> lck(m_sleep_mutex);
+            m_stop.store(true);
+            m_cond.notify_all();
+        }
+        for (auto it = m_threads.begin(); it != m_threads.end(); ++it) {
+            it->join();
+        }
+        for (size_t i = 0; i < m_deques.size(); ++i) {
+            delete m_deques[i];
+        }
+    }
+
+    int add_task(const T & task) {
+        if (m_max_size > 0 && m_pending.load(std::memory_order_relaxed) >= m_max_size) {
+            return -1;
+        }
+        submit(new T(task));
+
+        return 0;
+    }
+
+    int add_task(T && task) {
+        if (m_max_size > 0 && m_pending.load(std::memory_order_relaxed) >= m_max_size) {
+            return -1;
+        }
+        submit(new T(std::move(task)));
+
+        return 0;
+    }
+
+    // 已提交但尚未开始执行的任务数
+    size_t size() {
+        return m_pending.load(std::memory_order_relaxed);
+    }
+
+protected:
+    static void entry(void * pContext, int index) {
+        CThreadUtil::apply(((CWorkStealingTask *)pContext)->m_opt, index);
+        ((CWorkStealingTask *)pContext)->handle(index);
+    }
+
+    static Current & current() {
+        static thread_local Current cur = {nullptr, -1};
+        return cur;
+    }
+
+    void submit(T * task) {
+        // 先计数再入队, worker看到计数为0时才会park
+        m_pending.fetch_add(1, std::memory_order_seq_cst);
+
+        Current & cur = current();
+        if (cur.pool == this) {
+            m_deques[cur.index]->push(task);
+        } else {
+            std::unique_lock<std::mutex> lck(m_inject_mutex);
+            m_inject.push_back(task);
+        }
+
+        if (m_sleepers.load(std::memory_order_seq_cst) > 0) {
+            std::unique_lock<std::mutex> lck(m_sleep_mutex);
+            m_cond.notify_one();
+        }
+    }
+
+    void handle(int index) {
+        current().pool = this;
+        current().index = index;
+        uint32_t seed = (uint32_t)index * 2654435761u + 1;
+
+        while (1) {
+            T * task = find_task(index, seed);
+            if (task) {
+                m_pending.fetch_sub(1, std::memory_order_relaxed);
+                (*m_func)(std::move(*task));
+                delete task;
+                continue;
+            }
+
+            // 任务已计数但还未入队, 或正被其他worker取走
+            if (m_pending.load() > 0) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            if (m_stop.load()) {
+                return;
+            }
+
+            std::unique_lock<std::mutex> lck(m_sleep_mutex);
+            m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+            while (0 == m_pending.load(std::memory_order_seq_cst) && !m_stop.load()) {
+                m_cond.wait(lck);
+            }
+            m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    T * find_task(int index, uint32_t & seed) {
+        CChaseLevDeque<T> * local = m_deques[index];
+        T * task = local->take();
+        if (task) {
+            return task;
+        }
+
+        // 全局队列一次取一批, 多余的放入本地队列供其他worker窃取
+        {
+            std::unique_lock<std::mutex> lck(m_inject_mutex);
+            if (!m_inject.empty()) {
+                task = m_inject.front();
+                m_inject.pop_front();
+                for (int i = 1; i < WORK_STEALING_INJECT_BATCH && !m_inject.empty(); ++i) {
+                    local->push(m_inject.front());
+                    m_inject.pop_front();
+                }
+                return task;
+            }
+        }
+
+        size_t count = m_deques.size();
+        for (size_t i = 0; count > 1 && i < count * 2; ++i) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            size_t victim = seed % count;
+            if ((int)victim == index) {
+                continue;
+            }
+
+            task = m_deques[victim]->steal();
+            if (task) {
+                return task;
+            }
+        }
+
+        return nullptr;
+    }
+
+
+private:
+    void (*m_func)(T);
+    CThreadOptions m_opt;
+
+    std::list<std::thread> m_threads;
+    std::vector<CChaseLevDeque<T> *> m_deques;
+
+    std::mutex m_inject_mutex;
+    std::deque<T *> m_inject;
+
+    std::atomic<size_t> m_pending;
+    std::atomic<int> m_sleepers;
+    std::atomic<bool> m_stop;
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_cond;
+
+    size_t m_max_size;
+    size_t m_max_work;
+};
+
+#endif
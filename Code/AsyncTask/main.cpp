@@ -5,6 +5,12 @@
 #include <thread>     // C++11
 
 #include "AsyncTask.h"
+#include "MpscQueue.h"
+#include "WorkStealingTask.h"
+#include "TaskExecutor.h"
+#include "KeyedAsyncTask.h"
+#include "NodeAsyncTask.h"
+#include "PriorityAsyncTask.h"
 
 using std::string;
 
@@ -20,11 +26,26 @@ struct BlockTest {
 };
 
 void Async_handler(std::shared_ptr<BlockTest> pBlock);
+void Batch_handler(std::vector<std::shared_ptr<BlockTest>> & vecBlock);
+void Drop_handler(std::shared_ptr<BlockTest> pBlock);
+void Unique_handler(std::unique_ptr<BlockTest> pBlock);
+void Slow_handler(std::shared_ptr<BlockTest> pBlock);
+
+// 工作窃取: 区间求和, 区间过大时拆分成子任务
+struct SumRange {
+    int iBegin;
+    int iEnd;
+};
+
+static CWorkStealingTask<SumRange> *g_pStealTask = NULL;
+static std::atomic<long> g_lSum(0);
+void Sum_handler(SumRange range);
 
 
 int main()
 {
     std::shared_ptr<CAsyncTask<std::shared_ptr<BlockTest>>> pAsyncTask = std::make_shared<CAsyncTask<std::shared_ptr<BlockTest>>>(Async_handler, 2048, 1);
+    pAsyncTask->set_metrics(true);
 
     for(int i=0; i<LOOP_NUMS; ++i) {
         std::shared_ptr<BlockTest> block = std::make_shared<BlockTest>();
@@ -32,12 +53,150 @@ int main()
         block->strName = "Block";
 
         printf("TH_Send Name: %s, Version: %d\n", block->strName.c_str(), block->iVersion);
-        pAsyncTask->add_task(block);
+        pAsyncTask->add_task(std::move(block));
     }
 
+    // 停止接收并等待已提交的任务执行完, 最多等待1s
     printf("wait process block start\n");
+    bool bDrained = pAsyncTask->drain(1000);
+    CTaskMetrics metrics = pAsyncTask->metrics();
+    printf("wait process block end, drained: %d, done: %lu, max depth: %zu, wait p99: %luus, exec p99: %luus\n",
+           bDrained, metrics.done, metrics.max_depth, metrics.wait.percentile(0.99), metrics.exec.percentile(0.99));
+
+    // 关闭再开启: 忙碌比例从重新开启时算起, 直方图和done保持累计
+    pAsyncTask->set_metrics(false);
+    pAsyncTask->set_metrics(true);
+    metrics = pAsyncTask->metrics();
+    printf("metrics reopened, done: %lu, busy ratio: %.2f\n", metrics.done, metrics.busy_ratio.empty() ? 0.0 : metrics.busy_ratio[0]);
+
+    // 只能移动的任务类型: unique_ptr随任务转移所有权, 处理函数结束时释放
+    {
+        CAsyncTask<std::unique_ptr<BlockTest>> uniqueTask(Unique_handler, 2048, 1);
+        for (int i=0; i<LOOP_NUMS; ++i) {
+            std::unique_ptr<BlockTest> block(new BlockTest);
+            block->iVersion = i;
+            block->strName = "UniqueBlock";
+            uniqueTask.add_task(std::move(block));
+        }
+        uniqueTask.drain(1000);
+    }
+
+    // 多生产者场景使用无锁队列, add_task不加锁
+    CAsyncTask<std::shared_ptr<BlockTest>, CMpscQueue> mpscTask(Async_handler, 2048, 2);
+    std::thread producers[2];
+    for (int p=0; p<2; ++p) {
+        producers[p] = std::thread([&mpscTask, p]() {
+            for (int i=0; i<LOOP_NUMS; ++i) {
+                std::shared_ptr<BlockTest> block = std::make_shared<BlockTest>();
+                block->iVersion = p * LOOP_NUMS + i;
+                block->strName = "MpscBlock";
+                mpscTask.add_task(std::move(block));
+            }
+        });
+    }
+    for (int p=0; p<2; ++p) {
+        producers[p].join();
+    }
     sleep(1);
-    printf("wait process block end\n");
+
+    // 处理函数中add_task放入当前worker的本地队列, 空闲worker随机窃取
+    {
+        CWorkStealingTask<SumRange> stealTask(Sum_handler, 0, 4);
+        g_pStealTask = &stealTask;
+        SumRange range = {0, 1000000};
+        stealTask.add_task(range);
+        while (stealTask.size() > 0) {
+            usleep(1000);
+        }
+    }
+    printf("work stealing sum: %ld\n", g_lSum.load());
+
+    // 通用执行器: 同一组线程执行不同类型的任务, submit返回future
+    CTaskExecutor<> executor(2048, 2);
+    CTaskFuture<int> lenFuture = executor.submit([](const string & str) { return (int)str.size(); }, string("PublicComponent"));
+    CTaskFuture<string> nameFuture = executor.submit([](int iVersion) { return "Block_" + std::to_string(iVersion); }, 7);
+    executor.post([]() { printf("executor post\n"); });
+    executor.post([]() { throw std::runtime_error("post failed"); });
+    printf("executor len: %d, name: %s\n", lenFuture.get(), nameFuture.get().c_str());
+
+    // 按key保序: 同一用户的任务按提交顺序执行, 不同用户并行
+    {
+        CKeyedAsyncTask<std::shared_ptr<BlockTest>> keyedTask(Async_handler, 2048, 4);
+        for (int i=0; i<LOOP_NUMS; ++i) {
+            std::shared_ptr<BlockTest> block = std::make_shared<BlockTest>();
+            block->iVersion = i / 4;
+            block->strName = "User_" + std::to_string(i % 4);
+            keyedTask.add_task(i % 4, std::move(block));
+        }
+        sleep(1);
+    }
+
+    // 批量模式: 一次取走最多32个任务, 不足时最多再等5ms凑批
+    {
+        CAsyncTask<std::shared_ptr<BlockTest>> batchTask(Batch_handler, 2048, 1, 32, 5);
+        for (int i=0; i<LOOP_NUMS; ++i) {
+            std::shared_ptr<BlockTest> block = std::make_shared<BlockTest>();
+            block->iVersion = i;
+            block->strName = "BatchBlock";
+            batchTask.add_task(std::move(block));
+        }
+        sleep(1);
+    }
+
+    // 弹性模式: 1~4个worker, 队列长度达到64或持续非空10ms扩容, 空闲200ms缩容
+    // 每个任务耗时2ms, 一个worker处理不过来, 积压后逐个扩容到4; 停止提交后逐个退出到1
+    {
+        CAsyncTask<std::shared_ptr<BlockTest>> elasticTask(Slow_handler, 2048, 1);
+        elasticTask.set_elastic(1, 4, 64, 10, 200);
+        printf("elastic workers: %zu\n", elasticTask.workers());
+        for (int i=0; i<LOOP_NUMS*4; ++i) {
+            std::shared_ptr<BlockTest> block = std::make_shared<BlockTest>();
+            block->iVersion = i;
+            block->strName = "ElasticBlock";
+            elasticTask.add_task(std::move(block));
+            usleep(500);
+        }
+        printf("elastic workers under load: %zu\n", elasticTask.workers());
+        for (int i=0; i<20 && elasticTask.workers() > 1; ++i) {
+            usleep(100 * 1000);
+        }
+        printf("elastic workers after idle: %zu\n", elasticTask.workers());
+    }
+
+    // NUMA: 每个节点一个子池, worker绑定本节点CPU, 线程名为"node节点号-序号"; 任务放入提交线程所在节点
+    {
+        CNodeAsyncTask<std::shared_ptr<BlockTest>> nodeTask(Async_handler, 2048, 2, CThreadOptions("node"));
+        printf("numa nodes: %zu, local node: %d\n", nodeTask.node_count(), nodeTask.local_node());
+        for (int i=0; i<LOOP_NUMS; ++i) {
+            std::shared_ptr<BlockTest> block = std::make_shared<BlockTest>();
+            block->iVersion = i;
+            block->strName = "NodeBlock";
+            nodeTask.add_task(std::move(block));
+        }
+        sleep(1);
+    }
+
+    // 优先级: lane 0为用户请求, lane 2为后台任务, 后台任务排队超过10ms丢弃
+    // 每个任务耗时2ms, 总长度限制32: 队列满时用户请求挤出后台任务, 后台任务被拒绝
+    {
+        CPriorityAsyncTask<std::shared_ptr<BlockTest>> priorityTask(Slow_handler, 32, 1, 3, LANE_STRICT);
+        priorityTask.set_drop_handler(Drop_handler);
+        int iRejected = 0;
+        for (int i=0; i<LOOP_NUMS; ++i) {
+            std::shared_ptr<BlockTest> block = std::make_shared<BlockTest>();
+            block->iVersion = i;
+            block->strName = (i % 10 == 0) ? "UserBlock" : "BackgroundBlock";
+            int iRet = (i % 10 == 0) ? priorityTask.add_task(0, std::move(block)) : priorityTask.add_task(2, std::move(block), 10);
+            if (iRet != 0) {
+                ++iRejected;
+            }
+        }
+        sleep(1);
+
+        printf("priority rejected: %d, user lane popped: %lu\n", iRejected, priorityTask.stats(0).popped);
+        CLaneStats stats = priorityTask.stats(2);
+        printf("background lane popped: %lu, dropped: %lu, avg wait: %luus\n", stats.popped, stats.dropped, stats.wait_us_avg());
+    }
 
     return 0;
 }
@@ -47,3 +206,42 @@ void Async_handler(std::shared_ptr<BlockTest> pBlock)
     printf("Async_handler Name: %s, Version: %d\n", pBlock->strName.c_str(), pBlock->iVersion);
 }
 
+void Batch_handler(std::vector<std::shared_ptr<BlockTest>> & vecBlock)
+{
+    printf("Batch_handler Count: %zu, First: %d, Last: %d\n", vecBlock.size(), vecBlock.front()->iVersion, vecBlock.back()->iVersion);
+}
+
+void Drop_handler(std::shared_ptr<BlockTest> pBlock)
+{
+    printf("Drop_handler Name: %s, Version: %d\n", pBlock->strName.c_str(), pBlock->iVersion);
+}
+
+void Unique_handler(std::unique_ptr<BlockTest> pBlock)
+{
+    printf("Unique_handler Name: %s, Version: %d\n", pBlock->strName.c_str(), pBlock->iVersion);
+}
+
+// 模拟耗时任务
+void Slow_handler(std::shared_ptr<BlockTest> pBlock)
+{
+    usleep(2000);
+}
+
+
+void Sum_handler(SumRange range)
+{
+    if (range.iEnd - range.iBegin > 1000) {
+        int iMid = range.iBegin + (range.iEnd - range.iBegin) / 2;
+        SumRange left = {range.iBegin, iMid};
+        SumRange right = {iMid, range.iEnd};
+        g_pStealTask->add_task(left);
+        g_pStealTask->add_task(right);
+        return;
+    }
+
+    long lSum = 0;
+    for (int i = range.iBegin; i < range.iEnd; ++i) {
+        lSum += i;
+    }
+    g_lSum += lSum;
+}
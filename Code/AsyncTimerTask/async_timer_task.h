@@ -3,59 +3,116 @@
 #define ASYNC_TIMER_H_
 
 #include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sched.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
 #include <thread>
 #include <chrono>
-#include <queue>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <utility>
 #include <mutex>
 #include <condition_variable>
 #include "list_util.h"
+#include "ThreadUtil.h"
+#include "timer_queue.h"
+#include "timing_wheel.h"
+#include "timer_handle.h"
 
+const int TIMER_MASTER_CONDVAR = 1;     // 定时线程在条件变量上等待(默认)
+const int TIMER_MASTER_TIMERFD = 2;     // 定时线程在timerfd上等待, timerfd按最早到期时间设置
+const int TIMER_MASTER_EXTERNAL = 3;    // 不创建定时线程, 由调用者把get_fd()加入自己的epoll, 可读时调用process_expired()
 
-template <typename T>
+
+// TQueue为定时队列: CHeapTimerQueue(默认, 二叉堆)或CTimingWheel(分层时间轮, 插入O(1), 适合大量定时任务)
+// add_task的absTimestamp为系统时间(毫秒), 入队时换算为CLOCK_MONOTONIC时间, 之后系统时间跳变不影响已入队的任务
+// shards大于1时按CPU分片, 每个分片有自己的锁和定时队列, 多个生产者add_task不再竞争同一把锁;
+// 定时线程依次取出各分片的到期任务, 合并后一次交给worker. 带句柄的任务按entry地址固定在一个分片, 改期和到期由同一把锁保护
+template <typename T, template <typename> class TQueue = CHeapTimerQueue>
 class CAsyncTimerTask
 {
-public:
-    struct InnerTask {
-        T raw_task;
-        uint64_t timestamp_ms;
+    typedef CTimerEntry<T> Entry;
 
-        InnerTask(T task, uint64_t t)
-        : raw_task(task), timestamp_ms(t)
-        {}
+    // 定时队列中的节点: 普通任务直接存放task; 带句柄的任务存放在entry中, version用于识别改期前的旧节点
+    struct Timer {
+        T task;
+        std::shared_ptr<Entry> entry;
+        uint32_t version;
 
-        bool operator<(const InnerTask& other) const {
-            return (*this).timestamp_ms > other.timestamp_ms;
-        }
+        Timer() : task(), version(0) {}
+        explicit Timer(T && t) : task(std::move(t)), version(0) {}
+        Timer(const std::shared_ptr<Entry> & e, uint32_t v) : task(), entry(e), version(v) {}
     };
 
+    struct Shard {
+        std::mutex mtx;
+        TQueue<Timer> queue;
+        std::atomic<uint64_t> hint;     // 定时线程上次扫描后放入的最早到期时间
+
+        explicit Shard(const int tick_ms) : queue(tick_ms), hint(UINT64_MAX) {}
+    };
 
 public:
-    CAsyncTimerTask(void (*func)(T), const int max_size = 0, const int max_work = 1)
-    : m_func(func)
+    // opt设置线程名和CPU/NUMA绑定, worker线程名为"name-序号", 定时线程为"name-timer"
+    // tick_ms为时间轮的精度, 堆实现忽略; master_mode见TIMER_MASTER_*; shards为定时队列分片数, 一般取生产者线程数或CPU数
+    CAsyncTimerTask(void (*func)(T), const int max_size = 0, const int max_work = 1, const CThreadOptions & opt = CThreadOptions(),
+                    const int tick_ms = 1, const int master_mode = TIMER_MASTER_CONDVAR, const int shards = 1)
+    : m_opt(opt), m_func(func), m_count(0), m_mode(master_mode), m_timer_fd(-1), m_stop_fd(-1), m_next_wake_ms(UINT64_MAX)
     {
         m_max_size = max_size > 0 ? max_size : 0;
         m_max_work = max_work > 0 ? max_work : 1;
 
+        for (int i = 0; i < (shards > 0 ? shards : 1); ++i) {
+            m_shards.push_back(std::unique_ptr<Shard>(new Shard(tick_ms)));
+        }
+
+        if (TIMER_MASTER_CONDVAR != m_mode) {
+            m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            m_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (m_timer_fd < 0 || m_stop_fd < 0) {
+                fprintf(stderr, "create timerfd failed, use condition variable\n");
+                close_fds();
+                m_mode = TIMER_MASTER_CONDVAR;
+            }
+        }
+
         for (size_t i = 0; i < m_max_work; ++i) {
-            threads.push_back(std::thread(worker, (void *)this));
+            threads.push_back(std::thread(worker, (void *)this, i));
+        }
+        if (TIMER_MASTER_EXTERNAL != m_mode) {
+            threads.push_back(std::thread(master, (void *)this));
         }
-        threads.push_back(std::thread(master, (void *)this));
     }
 
     virtual ~CAsyncTimerTask() 
     {
         m_run = false;
+        if (m_stop_fd >= 0) {
+            uint64_t one = 1;
+            ssize_t ret = write(m_stop_fd, &one, sizeof(one));
+            (void)ret;
+        }
 
         // master中数据处理
         {
-            std::unique_lock<std::mutex> lck(m_mtx);
-
-            while (!m_timer_tasks.empty()) {
-                InnerTask inner_task = m_timer_tasks.top();
-                m_list.push_back(inner_task.raw_task);
-                m_timer_tasks.pop();
+            std::vector<Timer> timers;
+            std::vector<T> tasks;
+            for (size_t i = 0; i < m_shards.size(); ++i) {
+                std::unique_lock<std::mutex> shard_lck(m_shards[i]->mtx);
+                m_shards[i]->queue.pop_all(timers);
+                collect(timers, tasks);
             }
+            m_list.put_all(std::make_move_iterator(tasks.begin()), std::make_move_iterator(tasks.end()));
 
+            std::unique_lock<std::mutex> lck(m_mtx);
             m_cv.notify_all();
         }
 
@@ -65,89 +122,395 @@ public:
         for (auto it = threads.begin(); it != threads.end(); ++it) {
             it->join();
         }
+        close_fds();
+    }
+
+    // TIMER_MASTER_EXTERNAL时加入调用者的epoll(EPOLLIN), 其他模式返回-1
+    int get_fd() const
+    {
+        return TIMER_MASTER_EXTERNAL == m_mode ? m_timer_fd : -1;
+    }
+
+    // 处理到期任务并按下一个到期时间重新设置timerfd, 返回交给worker的任务数
+    // TIMER_MASTER_EXTERNAL时在get_fd()可读后调用, 可在任意线程调用
+    size_t process_expired()
+    {
+        uint64_t count = 0;
+        ssize_t ret = read(m_timer_fd, &count, sizeof(count));
+        (void)ret;
+
+        std::vector<Timer> timers;
+        std::vector<T> expired;
+        uint64_t next_ms = scan(timers, expired, UINT32_MAX);
+        {
+            std::unique_lock<std::mutex> lck(m_mtx);
+            next_ms = publish_locked(next_ms);
+            arm_locked(UINT64_MAX == next_ms ? 0 : next_ms);
+        }
+
+        m_list.put_all(std::make_move_iterator(expired.begin()), std::make_move_iterator(expired.end()));
+        return expired.size();
     }
     
-    int add_task(T & task, uint64_t absTimestamp)
+    // slack_ms: 允许推迟执行的时间, 到期时间在[absTimestamp, absTimestamp + slack_ms]内向粗粒度对齐,
+    // 相近的定时任务合并为一次唤醒, 减少定时线程的唤醒和worker队列的加锁次数
+    int add_task(const T & task, uint64_t absTimestamp, uint32_t slack_ms = 0)
     {
-        if (m_max_size > 0 && m_timer_tasks.size() >= m_max_size) {
-            fprintf(stderr, "process size too large, maxsize:%lu  cursize:%lu\n", m_max_size, m_timer_tasks.size());
+        return add_task(T(task), absTimestamp, slack_ms);
+    }
+
+    // 移动入队, 支持unique_ptr等只能移动的任务类型
+    int add_task(T && task, uint64_t absTimestamp, uint32_t slack_ms = 0)
+    {
+        if (!reserve()) {
             return -1;
         }
 
-        InnerTask inner_task(task, absTimestamp);
-        std::unique_lock<std::mutex> lck(m_mtx);
-        m_timer_tasks.push(inner_task);
-        m_cv.notify_one();
+        push(local_shard(), Timer(std::move(task)), apply_slack(to_mono(absTimestamp), slack_ms));
         return 0;
     }
 
+    // 返回可取消/改期的句柄; 失败时task不会被移走
+    int add_task(T && task, uint64_t absTimestamp, CTimerHandle<T> & handle, uint32_t slack_ms = 0)
+    {
+        if (!reserve()) {
+            return -1;
+        }
+
+        std::shared_ptr<Entry> entry = std::make_shared<Entry>(std::move(task), (void *)this, reschedule_entry);
+        handle = CTimerHandle<T>(entry);
+        push(entry_shard(entry.get()), Timer(entry, 0), apply_slack(to_mono(absTimestamp), slack_ms));
+        return 0;
+    }
+
+    int add_task(const T & task, uint64_t absTimestamp, CTimerHandle<T> & handle, uint32_t slack_ms = 0)
+    {
+        T copy(task);
+        return add_task(std::move(copy), absTimestamp, handle, slack_ms);
+    }
+
 protected:
     static void master(void * arg)
     {
-        ((CAsyncTimerTask<T> *)arg)->handle_master();
+        CAsyncTimerTask * task = (CAsyncTimerTask *)arg;
+        CThreadUtil::apply(task->m_opt, task->m_max_work);
+        if (!task->m_opt.name.empty()) {
+            CThreadUtil::set_name(task->m_opt.name + "-timer");
+        }
+        if (TIMER_MASTER_TIMERFD == task->m_mode) {
+            task->handle_timerfd();
+        } else {
+            task->handle_master();
+        }
+    }
+
+    // CTimerHandle::reschedule的实现, 放入新节点并使旧节点作废
+    static int reschedule_entry(void * owner, const std::shared_ptr<Entry> & entry, uint64_t absTimestamp)
+    {
+        CAsyncTimerTask * task = (CAsyncTimerTask *)owner;
+        Shard & shard = task->entry_shard(entry.get());
+        uint64_t due_ms = to_mono(absTimestamp);
+        {
+            std::unique_lock<std::mutex> lck(shard.mtx);
+            if (TIMER_PENDING != entry->state.load(std::memory_order_acquire)) {
+                return -1;
+            }
+
+            ++entry->version;
+            task->push_locked(shard, Timer(entry, entry->version), due_ms);
+        }
+        if (task->m_max_size > 0) {
+            task->m_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        task->wake(due_ms);
+        return 0;
+    }
+
+    // 与Linux内核的timer slack相同: 在[due_ms, due_ms + slack_ms]内取低位0最多的时间,
+    // 不同任务的到期时间落在同一个对齐点上, 由一次唤醒一起处理
+    static uint64_t apply_slack(uint64_t due_ms, uint32_t slack_ms)
+    {
+        if (0 == slack_ms) {
+            return due_ms;
+        }
+
+        uint64_t limit = due_ms + slack_ms;
+        uint64_t diff = due_ms ^ limit;
+        int bit = 63 - __builtin_clzll(diff);
+        uint64_t mask = ((uint64_t)1 << bit) - 1;
+        return limit & ~mask;
     }
 
-    static void worker(void * arg)
+    // 检查max_size并占用一个位置, 不限制时不访问共享计数
+    bool reserve()
     {
-        ((CAsyncTimerTask<T> *)arg)->handle_worker();
+        if (0 == m_max_size) {
+            return true;
+        }
+
+        size_t count = m_count.fetch_add(1, std::memory_order_relaxed);
+        if (count >= m_max_size) {
+            m_count.fetch_sub(1, std::memory_order_relaxed);
+            fprintf(stderr, "process size too large, maxsize:%lu  cursize:%lu\n", m_max_size, count);
+            return false;
+        }
+        return true;
+    }
+
+    // 普通任务放入当前CPU的分片
+    Shard & local_shard()
+    {
+        if (1 == m_shards.size()) {
+            return *m_shards[0];
+        }
+
+        int cpu = sched_getcpu();
+        size_t index = cpu >= 0 ? (size_t)cpu : std::hash<std::thread::id>()(std::this_thread::get_id());
+        return *m_shards[index % m_shards.size()];
+    }
+
+    Shard & entry_shard(const Entry * entry)
+    {
+        return *m_shards[((uintptr_t)entry >> 4) % m_shards.size()];
+    }
+
+    void push(Shard & shard, Timer && timer, uint64_t due_ms)
+    {
+        {
+            std::unique_lock<std::mutex> lck(shard.mtx);
+            push_locked(shard, std::move(timer), due_ms);
+        }
+        wake(due_ms);
+    }
+
+    // 调用者持有shard.mtx
+    void push_locked(Shard & shard, Timer && timer, uint64_t due_ms)
+    {
+        shard.queue.push(std::move(timer), due_ms);
+        if (due_ms < shard.hint.load(std::memory_order_relaxed)) {
+            shard.hint.store(due_ms);
+        }
+    }
+
+    // 依次取出各分片的到期任务, 返回最早的下一次处理时间, 没有任务时返回UINT64_MAX
+    uint64_t scan(std::vector<Timer> & timers, std::vector<T> & expired, uint64_t max_wait_ms)
+    {
+        uint64_t now_ms = mono_ms();
+        uint64_t next_ms = UINT64_MAX;
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            Shard & shard = *m_shards[i];
+            std::unique_lock<std::mutex> lck(shard.mtx);
+            shard.hint.store(UINT64_MAX);
+            shard.queue.pop_expired(now_ms, timers);
+            if (m_max_size > 0) {
+                m_count.fetch_sub(timers.size(), std::memory_order_relaxed);
+            }
+            collect(timers, expired);
+
+            if (shard.queue.size() > 0) {
+                uint64_t shard_ms = now_ms + shard.queue.next_wait_ms(now_ms, max_wait_ms);
+                next_ms = shard_ms < next_ms ? shard_ms : next_ms;
+            }
+        }
+        return next_ms;
+    }
+
+    // 调用者持有m_mtx; 公布下一次醒来的时间, 再检查扫描期间放入分片的任务
+    // 与push的顺序相反(先写hint再读m_next_wake_ms), 两边至少有一边能看到对方, 不会漏掉唤醒
+    uint64_t publish_locked(uint64_t next_ms)
+    {
+        m_next_wake_ms.store(next_ms);
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            uint64_t hint = m_shards[i]->hint.load();
+            next_ms = hint < next_ms ? hint : next_ms;
+        }
+        m_next_wake_ms.store(next_ms);
+        return next_ms;
+    }
+
+    static uint64_t mono_ms()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+
+    // 系统时间戳换算为CLOCK_MONOTONIC时间戳; 按纳秒换算后向上取整, 任务不会提前执行
+    static uint64_t to_mono(uint64_t abs_ms)
+    {
+        uint64_t wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t now_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+        uint64_t abs_ns = abs_ms * 1000000;
+        uint64_t due_ns = abs_ns > wall_ns ? now_ns + (abs_ns - wall_ns) : now_ns;
+        return (due_ns + 999999) / 1000000;
+    }
+
+    // 只有新任务早于当前等待的到期时间时才唤醒定时线程或重设timerfd
+    void wake(uint64_t due_ms)
+    {
+        if (due_ms >= m_next_wake_ms.load()) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lck(m_mtx);
+        if (due_ms >= m_next_wake_ms.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        if (TIMER_MASTER_CONDVAR == m_mode) {
+            m_next_wake_ms = due_ms;
+            m_cv.notify_one();
+        } else {
+            arm_locked(due_ms);
+        }
+    }
+
+    // 调用者持有m_mtx; 按CLOCK_MONOTONIC绝对时间设置timerfd, due_ms为0时停止
+    void arm_locked(uint64_t due_ms)
+    {
+        struct itimerspec its;
+        its.it_interval.tv_sec = 0;
+        its.it_interval.tv_nsec = 0;
+        its.it_value.tv_sec = due_ms / 1000;
+        its.it_value.tv_nsec = (due_ms % 1000) * 1000000;
+        if (0 == due_ms) {
+            m_next_wake_ms = UINT64_MAX;
+        } else {
+            m_next_wake_ms = due_ms;
+        }
+        timerfd_settime(m_timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+    }
+
+    void close_fds()
+    {
+        if (m_timer_fd >= 0) {
+            close(m_timer_fd);
+            m_timer_fd = -1;
+        }
+        if (m_stop_fd >= 0) {
+            close(m_stop_fd);
+            m_stop_fd = -1;
+        }
+    }
+
+    static void worker(void * arg, size_t index)
+    {
+        CThreadUtil::apply(((CAsyncTimerTask *)arg)->m_opt, index);
+        ((CAsyncTimerTask *)arg)->handle_worker();
     }
 
 
     // 一个主线程 判断时间
     void handle_master()
     {
+        std::vector<Timer> timers;
+        std::vector<T> expired;
         while(m_run) {
+            uint64_t next_ms = scan(timers, expired, 500);
+            if (!expired.empty()) {
+                // 各分片的到期任务合并后一次交给worker, 不阻塞add_task
+                m_list.put_all(std::make_move_iterator(expired.begin()), std::make_move_iterator(expired.end()));
+                expired.clear();
+            }
 
-            uint64_t sleep_time_ms = 500;   // 500ms
-
+            // 不同task有不同的dalay_time 信号量超时时间+信号通知, 最多等待500ms
             std::unique_lock<std::mutex> lck(m_mtx);
-            uint64_t cur_timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-
-            while (!m_timer_tasks.empty()) {
-                InnerTask inner_task = m_timer_tasks.top();
+            uint64_t cur_timestamp_ms = mono_ms();
+            if (next_ms > cur_timestamp_ms + 500) {
+                next_ms = cur_timestamp_ms + 500;
+            }
+            next_ms = publish_locked(next_ms);
+            if (m_run && next_ms > cur_timestamp_ms) {
+                m_cv.wait_for(lck, std::chrono::milliseconds(next_ms - cur_timestamp_ms));
+            }
+            m_next_wake_ms.store(0);    // 扫描期间的add_task不需要唤醒, 由publish_locked检查
+        }
+    }
 
-                if (cur_timestamp_ms >= inner_task.timestamp_ms) {
-                    m_list.push_back(inner_task.raw_task);
-                    m_timer_tasks.pop();
+    // timerfd定时线程: 在timerfd和停止用的eventfd上poll, 没有任务时不会醒来
+    void handle_timerfd()
+    {
+        struct pollfd fds[2];
+        fds[0].fd = m_timer_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = m_stop_fd;
+        fds[1].events = POLLIN;
+
+        while (1) {
+            fds[0].revents = 0;
+            fds[1].revents = 0;
+            int ret = poll(fds, 2, -1);
+            if (ret < 0 && EINTR != errno) {
+                fprintf(stderr, "timer poll failed, errno:%d\n", errno);
+                return;
+            }
+            if (fds[1].revents & POLLIN) {
+                return;
+            }
+            if (fds[0].revents & POLLIN) {
+                process_expired();
+            }
+        }
+    }
 
-                } else {
-                    sleep_time_ms = inner_task.timestamp_ms - cur_timestamp_ms;
-                    break;
-                }
+    // 调用者持有任务所在分片的锁; 取出可执行的任务, 已取消或已改期的旧节点直接丢弃
+    void collect(std::vector<Timer> & timers, std::vector<T> & out)
+    {
+        for (size_t i = 0; i < timers.size(); ++i) {
+            Timer & timer = timers[i];
+            if (!timer.entry) {
+                out.push_back(std::move(timer.task));
+                continue;
+            }
+            if (timer.version != timer.entry->version) {
+                continue;
             }
 
-            // 不同task有不同的dalay_time 信号量超时时间+信号通知
-            m_cv.wait_for(lck, std::chrono::milliseconds(sleep_time_ms));
+            int expect = TIMER_PENDING;
+            if (timer.entry->state.compare_exchange_strong(expect, TIMER_FIRED, std::memory_order_acq_rel)) {
+                out.push_back(std::move(timer.entry->task));
+            }
         }
+        timers.clear();
     }
 
-    // 多个从线程 执行函数
+    // 多个从线程 执行函数; 每次加锁取走队列的1/m_max_work(至多SHARE_MAX_BATCH个), 一批到期任务由各worker分摊
     void handle_worker() {
+        std::vector<T> tasks;
         while(1) {
-            T task;
-            if (!m_list.pop_front(task, TYPE_BLOCK)) {//will block
-                if (!m_run) {
-                    return;
-                }
-                usleep(30);
-                continue;
+            if (!m_list.wait_and_share(tasks, m_max_work)) {//will block
+                return;
             }
-            (*m_func)(task);
+            for (size_t i = 0; i < tasks.size(); ++i) {
+                (*m_func)(std::move(tasks[i]));
+            }
+            tasks.clear();
         }
     }
-        
+
 private:
-    bool m_run = true;
+    std::atomic<bool> m_run{true};
 
     size_t m_max_size;
     size_t m_max_work;
     std::list<std::thread> threads;
+    CThreadOptions m_opt;
 
     void (*m_func)(T);
 
-    std::mutex m_mtx;
+    std::vector<std::unique_ptr<Shard> > m_shards;
+    std::atomic<size_t> m_count;    // 定时队列中的节点数, 只在限制max_size时维护
+
+    std::mutex m_mtx;               // 保护定时线程的等待和timerfd设置
     std::condition_variable m_cv;
-    std::priority_queue<InnerTask> m_timer_tasks;
+
+    int m_mode;
+    int m_timer_fd;
+    int m_stop_fd;
+    std::atomic<uint64_t> m_next_wake_ms;   // 定时线程(或timerfd)下一次醒来的时间, 在m_mtx下修改
 
     CThreadSafeList<T> m_list;  // 防止任务耗时处理  影响任务处理  但是线程处理任务
 };
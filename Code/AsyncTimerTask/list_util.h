@@ -2,12 +2,19 @@
 #ifndef LIST_UTIL_H_
 #define LIST_UTIL_H_
 #include <list>
+#include <vector>
+#include <iterator>
+#include <utility>
+#include <atomic>
+#include <algorithm>
 #include <mutex>
 #include <condition_variable>
 
 const int TYPE_BLOCK = 1;
 const int TYPE_NOT_BLOCK = 2;
 
+const size_t SHARE_MAX_BATCH = 16;  // wait_and_share一次最多取走的元素数
+
 template <typename T>
 class CThreadSafeList
 {
@@ -25,13 +32,29 @@ public:
     bool is_stop() {
         return stop;
     }
-    void push_back(T & a) {
+    void push_back(const T & a) {
         std::unique_lock<std::mutex> lck(m_mtx);
         m_list.push_back(a);
         ++m_size;
         m_cv.notify_one();
     }
 
+    void push_back(T && a) {
+        std::unique_lock<std::mutex> lck(m_mtx);
+        m_list.push_back(std::move(a));
+        ++m_size;
+        m_cv.notify_one();
+    }
+
+    // 在队尾直接构造元素
+    template <typename... Args>
+    void emplace_back(Args &&... args) {
+        std::unique_lock<std::mutex> lck(m_mtx);
+        m_list.emplace_back(std::forward<Args>(args)...);
+        ++m_size;
+        m_cv.notify_one();
+    }
+
     bool pop_front(T & a, const int type = TYPE_BLOCK) {
         if (type == TYPE_NOT_BLOCK) {
             return getWithoutBlock(a);
@@ -44,7 +67,102 @@ public:
         return m_size;
     }
 
+    // 一次加锁取走最多max个元素(max为0时全部取走), 不阻塞, 返回取到的个数
+    size_t take_all(std::vector<T> & out, size_t max = 0) {
+        std::list<T> batch;
+        {
+            std::unique_lock<std::mutex> lck(m_mtx);
+            splice_front(batch, max);
+        }
+
+        return move_out(batch, out);
+    }
+
+    // 阻塞直到有数据, 每次唤醒取走一批; 停止且为空时返回false
+    bool wait_and_drain(std::vector<T> & out, size_t max = 0) {
+        std::list<T> batch;
+        {
+            std::unique_lock<std::mutex> lck(m_mtx);
+            while (m_list.empty()) {
+                if (stop) {
+                    return false;
+                }
+                m_cv.wait(lck);
+            }
+            splice_front(batch, max);
+        }
+
+        move_out(batch, out);
+        return true;
+    }
+
+    // 阻塞直到有数据, 取走当前元素的1/parts(至少一个, 至多SHARE_MAX_BATCH), 多个消费者分摊同一批数据;
+    // 上限避免大批到期时先醒的消费者拿走太多, 其余消费者空闲而尾部任务延迟; 停止且为空时返回false
+    bool wait_and_share(std::vector<T> & out, size_t parts) {
+        std::list<T> batch;
+        {
+            std::unique_lock<std::mutex> lck(m_mtx);
+            while (m_list.empty()) {
+                if (stop) {
+                    return false;
+                }
+                m_cv.wait(lck);
+            }
+            size_t share = parts > 1 ? m_list.size() / parts : m_list.size();
+            splice_front(batch, std::max((size_t)1, std::min(share, SHARE_MAX_BATCH)));
+        }
+
+        move_out(batch, out);
+        return true;
+    }
+
+    // 节点在锁外构造, 加锁后整体拼接到队尾
+    template <typename Iter>
+    void put_all(Iter first, Iter last) {
+        std::list<T> batch(first, last);
+        if (batch.empty()) {
+            return;
+        }
+
+        size_t count = batch.size();
+        std::unique_lock<std::mutex> lck(m_mtx);
+        m_list.splice(m_list.end(), batch);
+        m_size += count;
+        if (count > 1) {
+            m_cv.notify_all();
+        } else {
+            m_cv.notify_one();
+        }
+    }
+
+    template <typename Container>
+    void put_all(const Container & items) {
+        put_all(items.begin(), items.end());
+    }
+
 protected:
+    // 调用者持锁, 把队头最多max个节点拼接到batch
+    void splice_front(std::list<T> & batch, size_t max) {
+        if (0 == max || max >= m_list.size()) {
+            batch.swap(m_list);
+        } else {
+            typename std::list<T>::iterator it = m_list.begin();
+            std::advance(it, max);
+            batch.splice(batch.end(), m_list, m_list.begin(), it);
+        }
+        m_size -= batch.size();
+    }
+
+    // 锁外把batch中的元素移动到out
+    static size_t move_out(std::list<T> & batch, std::vector<T> & out) {
+        size_t count = batch.size();
+        out.reserve(out.size() + count);
+        for (typename std::list<T>::iterator it = batch.begin(); it != batch.end(); ++it) {
+            out.push_back(std::move(*it));
+        }
+        return count;
+    }
+
     bool getWithoutBlock(T & a) {
         std::unique_lock<std::mutex> lck(m_mtx, std::defer_lock);
         if (!lck.try_lock()) {
@@ -54,8 +172,9 @@ protected:
         if (m_list.empty()) {
             return false;
         }
-        a = m_list.front();
+        a = std::move(m_list.front());
         m_list.pop_front();
+        --m_size;
 
         return true;
     }
@@ -68,7 +187,7 @@ protected:
             }
             m_cv.wait(lck);
         }
-        a = m_list.front();
+        a = std::move(m_list.front());
         m_list.pop_front();
         --m_size;
 
@@ -80,7 +199,7 @@ private:
     std::condition_variable m_cv;
     std::mutex m_mtx;
     std::list<T> m_list;
-    uint64_t m_size;
+    std::atomic<uint64_t> m_size;  // size()不加锁读取
 };
 
 #endif /* LIST_UTIL_H_ */
@@ -4,6 +4,8 @@
 #include <string>
 #include <thread>
 #include <chrono>
+#include <memory>
+#include <sys/epoll.h>
 #include "async_timer_task.h"
 
 using std::string;
@@ -28,9 +30,18 @@ void async_handler(Context *ctx)
     return;
 }
 
-int main()
+// 只能移动的任务类型, 处理函数结束时释放
+void unique_handler(std::unique_ptr<Context> ctx)
+{
+    printf("unique handler ctx value:%lu\n", ctx->value);
+}
+
+// TQueue: CHeapTimerQueue(二叉堆) / CTimingWheel(分层时间轮)
+// master_mode: TIMER_MASTER_CONDVAR / TIMER_MASTER_TIMERFD; shards: 定时队列分片数
+template <template <typename> class TQueue>
+void run_timer(const char * name, const int tick_ms, const int master_mode = TIMER_MASTER_CONDVAR, const int shards = 1)
 {
-	CAsyncTimerTask<Context *>* _async = new CAsyncTimerTask<Context *>(async_handler, 1024000, 4);
+    CAsyncTimerTask<Context *, TQueue>* _async = new CAsyncTimerTask<Context *, TQueue>(async_handler, 1024000, 4, CThreadOptions(name), tick_ms, master_mode, shards);
 
     for (int i=0; i<100000; ++i) {
         Context* ctx = new Context;
@@ -42,7 +53,104 @@ int main()
     sleep(10);
 
     delete _async;
+}
+
+int main()
+{
+    run_timer<CHeapTimerQueue>("heap_timer", 1);
+
+    // 时间轮精度1ms, 插入O(1)
+    run_timer<CTimingWheel>("wheel_timer", 1);
+
+    // 边界: 第0层转完一圈时上层任务需要立即下放, 即使第0层还有更远的任务也不能按它等待
+    {
+        CTimingWheel<int> wheel(1);
+        uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        uint64_t boundary = ((now_ms >> 8) + 2) << 8;
+        wheel.push(1, boundary + 1);            // 距离超过256个tick, 放在第1层
+        std::vector<int> expired;
+        wheel.pop_expired(boundary - 51, expired);
+        wheel.push(2, boundary + 200);          // 第0层
+        wheel.pop_expired(boundary - 1, expired);
+        printf("wheel boundary wait:%lums (expect 0)\n", wheel.next_wait_ms(boundary, 1000));
+        wheel.pop_expired(boundary + 1, expired);
+        printf("wheel boundary expired:%zu first:%d\n", expired.size(), expired.empty() ? 0 : expired[0]);
+    }
+
+    // 定时线程在timerfd(CLOCK_MONOTONIC)上等待, 只在最早到期时间变化时重设
+    run_timer<CHeapTimerQueue>("timerfd_timer", 1, TIMER_MASTER_TIMERFD);
+
+    // 多个生产者线程时按CPU分片, add_task不竞争同一把锁
+    run_timer<CTimingWheel>("sharded_timer", 1, TIMER_MASTER_CONDVAR, 4);
+
+    // 不创建定时线程, 由网络线程的epoll驱动
+    {
+        CAsyncTimerTask<Context *> reactor_task(async_handler, 0, 1, CThreadOptions("reactor_timer"), 1, TIMER_MASTER_EXTERNAL);
+        int epfd = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = reactor_task.get_fd();
+        epoll_ctl(epfd, EPOLL_CTL_ADD, reactor_task.get_fd(), &ev);
+
+        uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        for (int i=0; i<10; ++i) {
+            Context* ctx = new Context;
+            ctx->value = now_ms;
+            reactor_task.add_task(ctx, now_ms + 100 * i);
+        }
+
+        size_t fired = 0;
+        while (fired < 10) {
+            struct epoll_event events[16];
+            int n = epoll_wait(epfd, events, 16, 1000);
+            for (int i=0; i<n; ++i) {
+                if (events[i].data.fd == reactor_task.get_fd()) {
+                    fired += reactor_task.process_expired();
+                }
+            }
+        }
+        printf("reactor timer fired:%lu\n", fired);
+        close(epfd);
+    }
+
+    // 允许推迟50ms: 相近的到期时间合并为一次唤醒, 一批任务一次交给worker
+    {
+        CAsyncTimerTask<Context *> slack_task(async_handler, 0, 2, CThreadOptions("slack_timer"));
+        uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        for (int i=0; i<1000; ++i) {
+            Context* ctx = new Context;
+            ctx->value = now_ms;
+            slack_task.add_task(ctx, now_ms + i, 50);
+        }
+        sleep(2);
+    }
+
+    // unique_ptr任务: 普通任务和带句柄的任务都直接移动入队
+    {
+        CAsyncTimerTask<std::unique_ptr<Context>, CTimingWheel> unique_task(unique_handler, 0, 1);
+        uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        std::unique_ptr<Context> ctx(new Context);
+        ctx->value = 1;
+        unique_task.add_task(std::move(ctx), now_ms + 100);
+
+        std::unique_ptr<Context> handle_ctx(new Context);
+        handle_ctx->value = 2;
+        CTimerHandle<std::unique_ptr<Context>> unique_handle;
+        unique_task.add_task(std::move(handle_ctx), now_ms + 100, unique_handle);
+        unique_handle.reschedule(now_ms + 200);
+        sleep(1);
+    }
+
+    // 请求超时定时器: 响应到达后取消, 取消的任务不会进入worker队列
+    CAsyncTimerTask<Context *, CTimingWheel> timeout_task(async_handler, 0, 1);
+    Context* ctx = new Context;
+    ctx->value = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    CTimerHandle<Context *> handle;
+    timeout_task.add_task(ctx, ctx->value + 1000, handle);
+    if (handle.cancel()) {
+        delete ctx;
+        printf("timeout timer cancelled\n");
+    }
 
     return 0;
 }
-
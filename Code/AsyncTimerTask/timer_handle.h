@@ -0,0 +1,69 @@
+#ifndef TIMER_HANDLE_H_
+#define TIMER_HANDLE_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+const int TIMER_PENDING = 0;
+const int TIMER_FIRED = 1;
+const int TIMER_CANCELLED = 2;
+
+
+// 定时任务与句柄共享的状态, 任务存放在这里而不是定时队列中, 改期时只需放入一个新的队列节点
+// 取消和改期都不从定时队列中删除节点(惰性删除): 节点到期时版本号不一致或已取消则直接丢弃, 不会进入worker队列
+template <typename T>
+struct CTimerEntry {
+    std::atomic<int> state;
+    uint32_t version;       // 由定时器的锁保护, 每次改期加一
+    T task;
+
+    void * owner;
+    int (*reschedule)(void * owner, const std::shared_ptr<CTimerEntry> & entry, uint64_t absTimestamp);
+
+    CTimerEntry(T && t, void * o, int (*r)(void *, const std::shared_ptr<CTimerEntry> &, uint64_t))
+        : state(TIMER_PENDING), version(0), task(std::move(t)), owner(o), reschedule(r) {}
+};
+
+
+// 定时任务句柄, 可拷贝; 改期需要访问定时器, 定时器析构后只能调用cancel/pending
+template <typename T>
+class CTimerHandle
+{
+public:
+    CTimerHandle() {}
+
+    explicit CTimerHandle(const std::shared_ptr<CTimerEntry<T> > & entry) : m_entry(entry) {}
+
+    bool valid() const {
+        return m_entry != nullptr;
+    }
+
+    // 尚未执行且未取消
+    bool pending() const {
+        return m_entry && TIMER_PENDING == m_entry->state.load(std::memory_order_acquire);
+    }
+
+    // O(1)无锁取消, 返回true表示任务不会再执行; 已执行或已取消返回false
+    bool cancel() {
+        if (!m_entry) {
+            return false;
+        }
+        int expect = TIMER_PENDING;
+        return m_entry->state.compare_exchange_strong(expect, TIMER_CANCELLED, std::memory_order_acq_rel);
+    }
+
+    // 改为absTimestamp执行, 旧的队列节点作废; 已执行或已取消返回-1
+    int reschedule(uint64_t absTimestamp) {
+        if (!m_entry) {
+            return -1;
+        }
+        return m_entry->reschedule(m_entry->owner, m_entry, absTimestamp);
+    }
+
+private:
+    std::shared_ptr<CTimerEntry<T> > m_entry;
+};
+
+
+#endif /* TIMER_HANDLE_H_ */
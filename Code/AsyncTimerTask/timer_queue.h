@@ -0,0 +1,92 @@
+#ifndef TIMER_QUEUE_H_
+#define TIMER_QUEUE_H_
+
+#include <stdint.h>
+#include <queue>
+#include <vector>
+#include <utility>
+
+
+// 二叉堆定时队列, CAsyncTimerTask的默认实现; 插入和出队O(log n), 到期时间精确到毫秒
+// 定时队列接口(调用者负责加锁):
+//   push(task, timestamp_ms)           放入任务
+//   pop_expired(now_ms, out)           取出所有到期任务
+//   pop_all(out)                       取出所有任务, 析构时使用
+//   next_wait_ms(now_ms, max_wait_ms)  距下一次需要处理的时间, 不超过max_wait_ms
+//   size()
+template <typename T>
+class CHeapTimerQueue
+{
+    struct InnerTask {
+        T raw_task;
+        uint64_t timestamp_ms;
+
+        InnerTask(T task, uint64_t t)
+        : raw_task(std::move(task)), timestamp_ms(t)
+        {}
+
+        bool operator<(const InnerTask& other) const {
+            return (*this).timestamp_ms > other.timestamp_ms;
+        }
+    };
+
+public:
+    // 堆实现不使用tick_ms, 参数只为与CTimingWheel接口一致
+    explicit CHeapTimerQueue(const int tick_ms = 1)
+    {
+        (void)tick_ms;
+    }
+
+    void push(T && task, uint64_t timestamp_ms)
+    {
+        m_heap.push(InnerTask(std::move(task), timestamp_ms));
+    }
+
+    void pop_expired(uint64_t now_ms, std::vector<T> & out)
+    {
+        while (!m_heap.empty() && now_ms >= m_heap.top().timestamp_ms) {
+            out.push_back(pop_top());
+        }
+    }
+
+    void pop_all(std::vector<T> & out)
+    {
+        while (!m_heap.empty()) {
+            out.push_back(pop_top());
+        }
+    }
+
+    uint64_t next_wait_ms(uint64_t now_ms, uint64_t max_wait_ms)
+    {
+        if (m_heap.empty()) {
+            return max_wait_ms;
+        }
+
+        uint64_t timestamp_ms = m_heap.top().timestamp_ms;
+        if (timestamp_ms <= now_ms) {
+            return 0;
+        }
+        return timestamp_ms - now_ms < max_wait_ms ? timestamp_ms - now_ms : max_wait_ms;
+    }
+
+    size_t size() const
+    {
+        return m_heap.size();
+    }
+
+private:
+    // priority_queue::top()只返回const引用, 任务在出堆前移出,
+    // 之后pop只会移动/比较timestamp_ms, 不会再访问已被移走的raw_task
+    T pop_top()
+    {
+        T task(std::move(const_cast<InnerTask &>(m_heap.top()).raw_task));
+        m_heap.pop();
+        return task;
+    }
+
+private:
+    std::priority_queue<InnerTask> m_heap;
+};
+
+
+#endif /* TIMER_QUEUE_H_ */
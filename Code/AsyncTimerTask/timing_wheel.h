@@ -0,0 +1,257 @@
+#ifndef TIMING_WHEEL_H_
+#define TIMING_WHEEL_H_
+
+#include <stdint.h>
+#include <new>
+#include <vector>
+#include <chrono>
+#include <utility>
+
+#define WHEEL_ROOT_BITS     8       // 第0层256个槽
+#define WHEEL_LEVEL_BITS    6       // 第1~3层各64个槽
+#define WHEEL_LEVELS        4       // 共覆盖2^26个tick, 1ms精度约18.6小时, 更远的任务到期前会重新放置
+#define WHEEL_FREE_NODES    4096    // 缓存的空闲节点数
+
+
+// 分层时间轮(Linux内核timer wheel的结构), 接口与CHeapTimerQueue一致, 调用者负责加锁
+// 插入O(1); 每个tick处理第0层一个槽, 第0层转完一圈时把上一层的一个槽重新分配到下层
+// 到期时间按tick向上取整, 任务不会提前执行, 最多延迟一个tick; 同一tick内的任务不保证顺序
+template <typename T>
+class CTimingWheel
+{
+    struct Node {
+        T task;
+        uint64_t timestamp_ms;
+        uint64_t expire_tick;
+        Node * next;
+    };
+
+public:
+    explicit CTimingWheel(const int tick_ms = 1)
+    : m_tick_ms(tick_ms > 0 ? tick_ms : 1), m_size(0), m_free(nullptr), m_free_count(0)
+    {
+        // 与CAsyncTimerTask一致使用单调时钟(CLOCK_MONOTONIC)
+        uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        m_current = now_ms / m_tick_ms;
+
+        for (int level = 0; level < WHEEL_LEVELS; ++level) {
+            m_slots[level].assign(slot_count(level), nullptr);
+        }
+    }
+
+    ~CTimingWheel()
+    {
+        for (int level = 0; level < WHEEL_LEVELS; ++level) {
+            for (size_t i = 0; i < m_slots[level].size(); ++i) {
+                free_chain(m_slots[level][i]);
+            }
+        }
+        while (m_free) {
+            Node * next = m_free->next;
+            ::operator delete(m_free);
+            m_free = next;
+        }
+    }
+
+    CTimingWheel(const CTimingWheel &) = delete;
+    void operator=(const CTimingWheel &) = delete;
+
+public:
+    void push(T && task, uint64_t timestamp_ms)
+    {
+        Node * node = alloc_node(std::move(task));
+        node->timestamp_ms = timestamp_ms;
+        node->expire_tick = (timestamp_ms + m_tick_ms - 1) / m_tick_ms;
+        place(node);
+        ++m_size;
+    }
+
+    // 推进到now_ms所在的tick, 到期任务放入out
+    void pop_expired(uint64_t now_ms, std::vector<T> & out)
+    {
+        uint64_t target = now_ms / m_tick_ms;
+        if (0 == m_size) {
+            if (target > m_current) {
+                m_current = target;
+            }
+            return;
+        }
+
+        while (m_current <= target && m_size > 0) {
+            cascade();
+
+            size_t index = m_current & slot_mask(0);
+            Node * node = m_slots[0][index];
+            m_slots[0][index] = nullptr;
+            while (node) {
+                Node * next = node->next;
+                out.push_back(std::move(node->task));
+                release_node(node);
+                --m_size;
+                node = next;
+            }
+            ++m_current;
+        }
+
+        if (target >= m_current) {
+            m_current = target + 1;
+        }
+    }
+
+    void pop_all(std::vector<T> & out)
+    {
+        for (int level = 0; level < WHEEL_LEVELS; ++level) {
+            for (size_t i = 0; i < m_slots[level].size(); ++i) {
+                Node * node = m_slots[level][i];
+                m_slots[level][i] = nullptr;
+                while (node) {
+                    Node * next = node->next;
+                    out.push_back(std::move(node->task));
+                    release_node(node);
+                    node = next;
+                }
+            }
+        }
+        m_size = 0;
+    }
+
+    // 第0层有任务时等到最近的非空槽, 否则等到第0层转完一圈需要从上层下放任务时
+    uint64_t next_wait_ms(uint64_t now_ms, uint64_t max_wait_ms)
+    {
+        if (0 == m_size) {
+            return max_wait_ms;
+        }
+
+        size_t root = slot_count(0);
+        size_t start = m_current & slot_mask(0);
+        // start为0时m_current本身就是下放上层任务的时刻, 上层下放的任务可能就在下一个tick到期, 不能按第0层的槽等待
+        uint64_t ticks = 0;
+        if (0 != start) {
+            ticks = root - start;
+            for (size_t i = 0; i < root - start; ++i) {
+                if (m_slots[0][start + i]) {
+                    ticks = i;
+                    break;
+                }
+            }
+        }
+
+        uint64_t wake_ms = (m_current + ticks) * m_tick_ms;
+        if (wake_ms <= now_ms) {
+            return 0;
+        }
+        return wake_ms - now_ms < max_wait_ms ? wake_ms - now_ms : max_wait_ms;
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    static size_t slot_count(int level)
+    {
+        return (size_t)1 << (0 == level ? WHEEL_ROOT_BITS : WHEEL_LEVEL_BITS);
+    }
+
+    static uint64_t slot_mask(int level)
+    {
+        return slot_count(level) - 1;
+    }
+
+    static int level_shift(int level)
+    {
+        return 0 == level ? 0 : WHEEL_ROOT_BITS + (level - 1) * WHEEL_LEVEL_BITS;
+    }
+
+    // 按距当前tick的距离选择层和槽, 已过期的放入当前槽
+    void place(Node * node)
+    {
+        uint64_t expire = node->expire_tick > m_current ? node->expire_tick : m_current;
+        uint64_t diff = expire - m_current;
+
+        int level = 0;
+        while (level < WHEEL_LEVELS - 1 && diff >= ((uint64_t)1 << level_shift(level + 1))) {
+            ++level;
+        }
+
+        // 超出范围的放在最高层最远的槽, 下放时按真实到期时间重新放置
+        uint64_t limit = (uint64_t)1 << (level_shift(WHEEL_LEVELS - 1) + WHEEL_LEVEL_BITS);
+        if (diff >= limit) {
+            expire = m_current + limit - 1;
+        }
+
+        size_t index = (expire >> level_shift(level)) & slot_mask(level);
+        node->next = m_slots[level][index];
+        m_slots[level][index] = node;
+    }
+
+    // 第0层转到槽0时, 下放上一层当前槽, 逐层向上
+    void cascade()
+    {
+        for (int level = 1; level < WHEEL_LEVELS; ++level) {
+            if (0 != (m_current & (((uint64_t)1 << level_shift(level)) - 1))) {
+                break;
+            }
+
+            size_t index = (m_current >> level_shift(level)) & slot_mask(level);
+            Node * node = m_slots[level][index];
+            m_slots[level][index] = nullptr;
+            while (node) {
+                Node * next = node->next;
+                place(node);
+                node = next;
+            }
+        }
+    }
+
+    Node * alloc_node(T && task)
+    {
+        void * mem = nullptr;
+        if (m_free) {
+            mem = m_free;
+            m_free = m_free->next;
+            --m_free_count;
+        } else {
+            mem = ::operator new(sizeof(Node));
+        }
+
+        Node * node = (Node *)mem;
+        new (&node->task) T(std::move(task));
+        return node;
+    }
+
+    void release_node(Node * node)
+    {
+        node->task.~T();
+        if (m_free_count < WHEEL_FREE_NODES) {
+            node->next = m_free;
+            m_free = node;
+            ++m_free_count;
+        } else {
+            ::operator delete(node);
+        }
+    }
+
+    void free_chain(Node * node)
+    {
+        while (node) {
+            Node * next = node->next;
+            node->task.~T();
+            ::operator delete(node);
+            node = next;
+        }
+    }
+
+private:
+    uint64_t m_tick_ms;
+    uint64_t m_current;     // 下一个要处理的tick
+    size_t m_size;
+
+    std::vector<Node *> m_slots[WHEEL_LEVELS];
+    Node * m_free;          // 空闲节点链表, 节点内的task已析构
+    size_t m_free_count;
+};
+
+
+#endif /* TIMING_WHEEL_H_ */
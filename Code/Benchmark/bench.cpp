@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "bench.h"
+
+
+CPerfCounter::CPerfCounter() : m_fd(-1)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // pid=0 cpu=-1: 当前进程, inherit统计之后创建的线程
+    m_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+CPerfCounter::~CPerfCounter()
+{
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+void CPerfCounter::start()
+{
+    if (m_fd >= 0) {
+        ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+int64_t CPerfCounter::stop()
+{
+    if (m_fd < 0) {
+        return -1;
+    }
+
+    ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+
+    int64_t count = 0;
+    if (read(m_fd, &count, sizeof(count)) != sizeof(count)) {
+        return -1;
+    }
+    return count;
+}
+
+void bench_pin_thread(const BenchConfig &cfg, int index)
+{
+    if (cfg.cpus.empty()) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cfg.cpus[index % cfg.cpus.size()], &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "pin thread %d to cpu %d failed\n", index, cfg.cpus[index % cfg.cpus.size()]);
+    }
+}
+
+void bench_percentile(std::vector<uint64_t> &latency, BenchResult &result)
+{
+    if (latency.empty()) {
+        return;
+    }
+
+    std::sort(latency.begin(), latency.end());
+    size_t n = latency.size();
+    result.p50_ns = latency[n * 50 / 100];
+    result.p99_ns = latency[std::min(n - 1, n * 99 / 100)];
+    result.p999_ns = latency[std::min(n - 1, n * 999 / 1000)];
+    result.max_ns = latency[n - 1];
+}
+
+void bench_report(const char *name, const BenchConfig &cfg, const BenchResult &result)
+{
+    static const char *topo_name[] = {"1p1c", "np1c", "npmc"};
+
+    char misses[32] = "n/a";
+    if (result.cache_misses >= 0) {
+        snprintf(misses, sizeof(misses), "%.2f", (double)result.cache_misses / (result.items ? result.items : 1));
+    }
+
+    char threads[32];
+    snprintf(threads, sizeof(threads), "%dP%dC", cfg.producers, cfg.consumers);
+
+    printf("%-18s %-5s %-6s %6dB %12.0f %10lu %10lu %10lu %10lu %12s\n",
+           name, topo_name[cfg.topology], threads, cfg.payload,
+           result.seconds > 0 ? result.items / result.seconds : 0.0,
+           (unsigned long)result.p50_ns, (unsigned long)result.p99_ns,
+           (unsigned long)result.p999_ns, (unsigned long)result.max_ns, misses);
+}
@@ -0,0 +1,234 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_RDTSC 1
+#endif
+
+#define BENCH_CPU_RELAX() std::this_thread::yield()
+
+
+enum BENCH_TOPOLOGY {
+    TOPO_1P1C = 0,
+    TOPO_NP1C = 1,
+    TOPO_NPMC = 2,
+};
+
+struct BenchConfig {
+    int topology = TOPO_1P1C;
+    int producers = 1;
+    int consumers = 1;
+    int payload = 64;               // 字节
+    uint64_t count = 1000000;       // 每个生产者发送的条数
+    bool use_rdtsc = true;
+    std::vector<int> cpus;          // 绑核列表, 线程按顺序轮流绑定, 为空不绑核
+};
+
+struct BenchResult {
+    double seconds = 0;
+    uint64_t items = 0;
+    uint64_t p50_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+    uint64_t max_ns = 0;
+    int64_t cache_misses = -1;      // -1 表示perf_event不可用
+};
+
+// 队列中传递的数据; ts为0表示结束标记
+struct BenchItem {
+    uint64_t ts;
+    std::string payload;
+
+    BenchItem() : ts(0) {}
+};
+
+
+// 时间戳: 优先rdtsc, 启动时与steady_clock校准
+class CBenchClock {
+public:
+    static CBenchClock &instance() {
+        static CBenchClock clock;
+        return clock;
+    }
+
+    void set_rdtsc(bool use) {
+#ifdef BENCH_HAS_RDTSC
+        m_rdtsc = use;
+#else
+        (void)use;
+#endif
+    }
+
+    bool is_rdtsc() const { return m_rdtsc; }
+
+    uint64_t now() const {
+#ifdef BENCH_HAS_RDTSC
+        if (m_rdtsc) {
+            return __rdtsc();
+        }
+#endif
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    uint64_t to_ns(uint64_t ticks) const {
+        return m_rdtsc ? (uint64_t)(ticks * m_ns_per_tick) : ticks;
+    }
+
+private:
+    CBenchClock() : m_rdtsc(false), m_ns_per_tick(1.0) {
+#ifdef BENCH_HAS_RDTSC
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = __rdtsc();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        uint64_t c1 = __rdtsc();
+        auto t1 = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        m_ns_per_tick = ns / (double)(c1 - c0);
+        m_rdtsc = true;
+#endif
+    }
+
+    bool m_rdtsc;
+    double m_ns_per_tick;
+};
+
+
+// perf_event_open统计整个进程(含之后创建的线程)的cache miss
+class CPerfCounter {
+public:
+    CPerfCounter();
+    ~CPerfCounter();
+
+    void start();
+    int64_t stop();
+
+private:
+    int m_fd;
+};
+
+void bench_pin_thread(const BenchConfig &cfg, int index);
+void bench_report(const char *name, const BenchConfig &cfg, const BenchResult &result);
+void bench_percentile(std::vector<uint64_t> &latency, BenchResult &result);
+
+
+// 通用测试流程; Adapter需要提供:
+//   void push(int producer, BenchItem &item)   item可被移走
+//   bool pop(BenchItem &item)   阻塞或返回false后重试
+template <typename Adapter>
+void bench_run(Adapter &queue, const BenchConfig &cfg, BenchResult &result)
+{
+    CBenchClock &clock = CBenchClock::instance();
+    std::string payload(cfg.payload, 'x');
+
+    std::vector<std::vector<uint64_t>> latency(cfg.consumers);
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    int total_threads = cfg.producers + cfg.consumers;
+
+    // inherit只跟随打开之后创建的线程, 必须在创建线程前打开; 开始计数时ENABLE会作用到各线程的子计数器
+    CPerfCounter perf;
+
+    std::vector<std::thread> threads;
+    for (int c = 0; c < cfg.consumers; ++c) {
+        threads.push_back(std::thread([&, c]() {
+            bench_pin_thread(cfg, cfg.producers + c);
+            std::vector<uint64_t> &lat = latency[c];
+            lat.reserve(cfg.count * cfg.producers / cfg.consumers + 16);
+
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {}
+
+            BenchItem item;
+            while (true) {
+                if (!queue.pop(item)) {
+                    BENCH_CPU_RELAX();
+                    continue;
+                }
+                if (0 == item.ts) {
+                    break;
+                }
+                uint64_t now = clock.now();
+                lat.push_back(clock.to_ns(now > item.ts ? now - item.ts : 0));
+            }
+        }));
+    }
+
+    for (int p = 0; p < cfg.producers; ++p) {
+        threads.push_back(std::thread([&, p]() {
+            bench_pin_thread(cfg, p);
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {}
+
+            for (uint64_t i = 0; i < cfg.count; ++i) {
+                BenchItem item;
+                item.payload = payload;
+                item.ts = clock.now();
+                queue.push(p, item);
+            }
+        }));
+    }
+
+    while (ready.load() < total_threads) {
+        std::this_thread::yield();
+    }
+
+    perf.start();
+    auto t0 = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+
+    for (int p = 0; p < cfg.producers; ++p) {
+        threads[cfg.consumers + p].join();
+    }
+
+    // 每个消费者一个结束标记
+    for (int c = 0; c < cfg.consumers; ++c) {
+        BenchItem stop;
+        queue.push(0, stop);
+    }
+
+    for (int c = 0; c < cfg.consumers; ++c) {
+        threads[c].join();
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+    result.cache_misses = perf.stop();
+    result.seconds = std::chrono::duration<double>(t1 - t0).count();
+
+    std::vector<uint64_t> all;
+    for (int c = 0; c < cfg.consumers; ++c) {
+        all.insert(all.end(), latency[c].begin(), latency[c].end());
+    }
+    result.items = all.size();
+    bench_percentile(all, result);
+}
+
+
+// 各组件的测试入口, 返回false表示不支持该拓扑
+bool bench_ringbuf(const BenchConfig &cfg, BenchResult &result);
+bool bench_ringbuffer(const BenchConfig &cfg, BenchResult &result);
+bool bench_sequence_ring(const BenchConfig &cfg, BenchResult &result);
+bool bench_block_queue_1(const BenchConfig &cfg, BenchResult &result);
+bool bench_block_queue_2(const BenchConfig &cfg, BenchResult &result);
+bool bench_thread_safe_list(const BenchConfig &cfg, BenchResult &result);
+bool bench_mpsc_queue(const BenchConfig &cfg, BenchResult &result);
+
+// 定时器插入吞吐和执行延迟, producers为插入线程数, consumers为worker数
+bool bench_timer_heap(const BenchConfig &cfg, BenchResult &result);
+bool bench_timer_wheel(const BenchConfig &cfg, BenchResult &result);
+bool bench_timer_sharded(const BenchConfig &cfg, BenchResult &result);
+
+#endif // BENCH_H_
@@ -0,0 +1,36 @@
+#include <deque>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <pthread.h>
+#include "bench.h"
+
+// queue_1与queue_2的类名及include guard相同, 分别放在独立的命名空间和编译单元中
+namespace queue_1 {
+#include "../QueueThreadSafe/queue_1/BlockQueue.h"
+}
+
+
+class CBlockQueue1Adapter {
+public:
+    void push(int, BenchItem &item) {
+        m_queue.put(std::move(item));
+    }
+
+    bool pop(BenchItem &item) {
+        item = m_queue.take();
+        return true;
+    }
+
+private:
+    queue_1::CBlockQueue<BenchItem> m_queue;
+};
+
+
+bool bench_block_queue_1(const BenchConfig &cfg, BenchResult &result)
+{
+    CBlockQueue1Adapter queue;
+    bench_run(queue, cfg, result);
+    return true;
+}
@@ -0,0 +1,37 @@
+#include <deque>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+#include "bench.h"
+
+// queue_1与queue_2的类名及include guard相同, 分别放在独立的命名空间和编译单元中
+namespace queue_2 {
+#include "../QueueThreadSafe/queue_2/BlockQueue.h"
+}
+
+
+class CBlockQueue2Adapter {
+public:
+    void push(int, BenchItem &item) {
+        m_queue.put(std::move(item));
+    }
+
+    bool pop(BenchItem &item) {
+        item = m_queue.take();
+        return true;
+    }
+
+private:
+    queue_2::CBlockQueue<BenchItem> m_queue;
+};
+
+
+bool bench_block_queue_2(const BenchConfig &cfg, BenchResult &result)
+{
+    CBlockQueue2Adapter queue;
+    bench_run(queue, cfg, result);
+    return true;
+}
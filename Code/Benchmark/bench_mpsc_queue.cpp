@@ -0,0 +1,38 @@
+#include <limits.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+#include "bench.h"
+
+namespace async_task {
+#include "../AsyncTask/MpscQueue.h"
+}
+
+
+class CMpscQueueAdapter {
+public:
+    void push(int, BenchItem &item) {
+        m_queue.push_back(std::move(item));
+    }
+
+    bool pop(BenchItem &item) {
+        return m_queue.pop_front(item, async_task::TYPE_BLOCK);
+    }
+
+private:
+    async_task::CMpscQueue<BenchItem> m_queue;
+};
+
+
+bool bench_mpsc_queue(const BenchConfig &cfg, BenchResult &result)
+{
+    CMpscQueueAdapter queue;
+    bench_run(queue, cfg, result);
+    return true;
+}
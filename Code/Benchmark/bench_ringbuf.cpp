@@ -0,0 +1,102 @@
+#include "bench.h"
+#include "../RingBuf/RingBuf.h"
+#include "../RingBuf/RingBuffer.h"
+
+#define BENCH_RING_SIZE     65536
+
+
+// CRingBuf存放payload, CRingBuffer传递节点, 与RingBuf/main.cpp的用法一致
+struct RingNode {
+    uint64_t ts;
+    char *data;
+    unsigned int len;
+
+    RingNode() : ts(0), data(NULL), len(0) {}
+};
+
+class CRingBufAdapter {
+public:
+    CRingBufAdapter() {
+        // 预缺页, 避免首轮写入的缺页计入延迟
+        m_data.Init(BENCH_RING_SIZE * 128, RING_ALLOC_THP | RING_ALLOC_PREFAULT);
+        m_data.SetReportInterval(3600 * 1000);
+        m_nodes.SetReportInterval(3600 * 1000);
+    }
+
+    void push(int, BenchItem &item) {
+        RingNode node;
+        node.ts = item.ts;
+        if (0 != item.ts) {
+            while (NULL == (node.data = m_data.Write((char *)item.payload.data(), item.payload.size()))) {
+                BENCH_CPU_RELAX();
+            }
+            node.len = item.payload.size();
+        }
+
+        while (!m_nodes.Push(node)) {
+            BENCH_CPU_RELAX();
+        }
+    }
+
+    bool pop(BenchItem &item) {
+        RingNode node;
+        if (!m_nodes.Pop(node)) {
+            return false;
+        }
+
+        item.ts = node.ts;
+        if (NULL != node.data) {
+            item.payload.assign(node.data, node.len);
+            m_data.SetRead(node.data);
+        }
+        return true;
+    }
+
+private:
+    CRingBuf m_data;
+    CRingBuffer<RingNode, BENCH_RING_SIZE> m_nodes;
+};
+
+class CRingBufferAdapter {
+public:
+    CRingBufferAdapter() {
+        m_ring.SetReportInterval(3600 * 1000);
+    }
+
+    void push(int, BenchItem &item) {
+        while (!m_ring.Push(item)) {
+            BENCH_CPU_RELAX();
+        }
+    }
+
+    bool pop(BenchItem &item) {
+        return m_ring.Pop(item);
+    }
+
+private:
+    CRingBuffer<BenchItem, BENCH_RING_SIZE> m_ring;
+};
+
+
+// 两者都是单生产者/单消费者
+bool bench_ringbuf(const BenchConfig &cfg, BenchResult &result)
+{
+    if (TOPO_1P1C != cfg.topology) {
+        return false;
+    }
+
+    CRingBufAdapter queue;
+    bench_run(queue, cfg, result);
+    return true;
+}
+
+bool bench_ringbuffer(const BenchConfig &cfg, BenchResult &result)
+{
+    if (TOPO_1P1C != cfg.topology) {
+        return false;
+    }
+
+    CRingBufferAdapter queue;
+    bench_run(queue, cfg, result);
+    return true;
+}
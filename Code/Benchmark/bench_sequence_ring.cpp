@@ -0,0 +1,54 @@
+#include "bench.h"
+#include "../RingBuf/SequenceRing.h"
+
+#define BENCH_SEQ_RING_SIZE     65536
+
+
+// 单阶段: 消费者通过屏障批量取得可读序号, 每取一条推进自己的序号作为生产者的gating
+class CSequenceRingAdapter {
+public:
+    CSequenceRingAdapter() : m_llNext(0), m_llAvailable(-1) {
+        m_pBarrier = m_ring.NewBarrier();
+        m_ring.AddGatingSequence(&m_consumed);
+    }
+
+    void push(int, BenchItem &item) {
+        int64_t llSeq = m_ring.Next();
+        m_ring[llSeq] = std::move(item);
+        m_ring.Publish(llSeq);
+    }
+
+    bool pop(BenchItem &item) {
+        if (m_llNext > m_llAvailable) {
+            m_llAvailable = m_pBarrier->WaitFor(m_llNext);
+            if (m_llNext > m_llAvailable) {
+                return false;
+            }
+        }
+
+        item = std::move(m_ring[m_llNext]);
+        m_consumed.Set(m_llNext);
+        ++m_llNext;
+        return true;
+    }
+
+private:
+    CSequenceRing<BenchItem, BENCH_SEQ_RING_SIZE> m_ring;
+    CSequenceBarrier *m_pBarrier;
+    CSequence m_consumed;
+    int64_t m_llNext;
+    int64_t m_llAvailable;
+};
+
+
+// 单生产者; 多个消费者在Disruptor中是多个阶段而不是分摊数据, 只测1P1C
+bool bench_sequence_ring(const BenchConfig &cfg, BenchResult &result)
+{
+    if (TOPO_1P1C != cfg.topology) {
+        return false;
+    }
+
+    CSequenceRingAdapter queue;
+    bench_run(queue, cfg, result);
+    return true;
+}
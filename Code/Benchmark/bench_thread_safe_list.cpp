@@ -0,0 +1,36 @@
+#include <list>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include <iterator>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+#include "bench.h"
+
+namespace list_thread_safe {
+#include "../ListThreadSafe/ThreadSafeList.h"
+}
+
+
+class CThreadSafeListAdapter {
+public:
+    void push(int, BenchItem &item) {
+        m_list.push_back(std::move(item));
+    }
+
+    bool pop(BenchItem &item) {
+        return m_list.pop_front(item, list_thread_safe::TYPE_BLOCK);
+    }
+
+private:
+    list_thread_safe::CThreadSafeList<BenchItem> m_list;
+};
+
+
+bool bench_thread_safe_list(const BenchConfig &cfg, BenchResult &result)
+{
+    CThreadSafeListAdapter list;
+    bench_run(list, cfg, result);
+    return true;
+}
@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <new>
+#include <list>
+#include <queue>
+#include <string>
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <utility>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include "bench.h"
+
+namespace async_timer {
+#include "../AsyncTimerTask/async_timer_task.h"
+}
+
+
+// 定时器测试: 生产者插入定时任务(延迟0~999ms), worker记录实际执行时间与到期时间的差
+// items/s为插入吞吐, 延迟列为到期后多久开始执行
+static std::vector<uint64_t> g_lateness;
+static std::atomic<size_t> g_fired(0);
+
+static uint64_t steady_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void timer_handler(uint64_t due_ns)
+{
+    uint64_t now = steady_ns();
+    size_t index = g_fired.fetch_add(1);
+    if (index < g_lateness.size()) {
+        g_lateness[index] = now > due_ns ? now - due_ns : 0;
+    }
+}
+
+template <template <typename> class TQueue>
+static void bench_timer_run(const BenchConfig &cfg, BenchResult &result, int shards)
+{
+    size_t total = cfg.count * cfg.producers;
+    g_lateness.assign(total, 0);
+    g_fired.store(0);
+
+    // 在创建worker和生产者线程之前打开, 见bench_run
+    CPerfCounter perf;
+    async_timer::CAsyncTimerTask<uint64_t, TQueue> timer(timer_handler, 0, cfg.consumers, async_timer::CThreadOptions(), 1,
+                                                         async_timer::TIMER_MASTER_CONDVAR, shards);
+
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < cfg.producers; ++p) {
+        threads.push_back(std::thread([&, p]() {
+            bench_pin_thread(cfg, p);
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {}
+
+            for (uint64_t i = 0; i < cfg.count; ++i) {
+                uint64_t delay_ms = (i * 7 + p) % 1000;
+                uint64_t wall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+                timer.add_task(steady_ns() + delay_ms * 1000000, wall_ms + delay_ms);
+            }
+        }));
+    }
+
+    while (ready.load() < cfg.producers) {
+        std::this_thread::yield();
+    }
+
+    perf.start();
+    auto t0 = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+    result.cache_misses = perf.stop();
+    result.seconds = std::chrono::duration<double>(t1 - t0).count();
+
+    // 等最后一批定时任务执行完
+    while (g_fired.load() < total) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    result.items = total;
+    bench_percentile(g_lateness, result);
+}
+
+bool bench_timer_heap(const BenchConfig &cfg, BenchResult &result)
+{
+    bench_timer_run<async_timer::CHeapTimerQueue>(cfg, result, 1);
+    return true;
+}
+
+bool bench_timer_wheel(const BenchConfig &cfg, BenchResult &result)
+{
+    bench_timer_run<async_timer::CTimingWheel>(cfg, result, 1);
+    return true;
+}
+
+// 每个生产者一个分片
+bool bench_timer_sharded(const BenchConfig &cfg, BenchResult &result)
+{
+    bench_timer_run<async_timer::CTimingWheel>(cfg, result, cfg.producers);
+    return true;
+}
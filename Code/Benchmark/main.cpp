@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+
+
+struct BenchCase {
+    const char *name;
+    bool (*func)(const BenchConfig &cfg, BenchResult &result);
+};
+
+static BenchCase g_cases[] = {
+    {"ringbuf",         bench_ringbuf},
+    {"ringbuffer",      bench_ringbuffer},
+    {"sequence_ring",   bench_sequence_ring},
+    {"block_queue_1",   bench_block_queue_1},
+    {"block_queue_2",   bench_block_queue_2},
+    {"thread_safe_list", bench_thread_safe_list},
+    {"mpsc_queue",      bench_mpsc_queue},
+    {"timer_heap",      bench_timer_heap},
+    {"timer_wheel",     bench_timer_wheel},
+    {"timer_sharded",   bench_timer_sharded},
+};
+
+
+static void usage(const char *prog)
+{
+    printf("usage: %s [-q queue] [-t topology] [-p producers] [-c consumers] [-s payload] [-n count] [-a cpus] [-C]\n", prog);
+    printf("  -q  ringbuf|ringbuffer|sequence_ring|block_queue_1|block_queue_2|thread_safe_list|mpsc_queue|timer_heap|timer_wheel|timer_sharded|all (default all)\n");
+    printf("  -t  1p1c|np1c|npmc|all (default all)\n");
+    printf("  -p  producers for np1c/npmc (default 4)\n");
+    printf("  -c  consumers for npmc (default 4)\n");
+    printf("  -s  payload bytes (default 64)\n");
+    printf("  -n  items per producer (default 1000000)\n");
+    printf("  -a  pin threads to cpus, e.g. 0,2,4,6 (producers first, then consumers)\n");
+    printf("  -C  use steady_clock instead of rdtsc\n");
+}
+
+static std::vector<int> parse_cpus(const char *arg)
+{
+    std::vector<int> cpus;
+    std::string str(arg);
+    size_t pos = 0;
+    while (pos < str.size()) {
+        size_t next = str.find(',', pos);
+        if (next == std::string::npos) {
+            next = str.size();
+        }
+        cpus.push_back(atoi(str.substr(pos, next - pos).c_str()));
+        pos = next + 1;
+    }
+    return cpus;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string queue = "all";
+    std::string topology = "all";
+    int producers = 4;
+    int consumers = 4;
+    BenchConfig base;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "q:t:p:c:s:n:a:Ch")) != -1) {
+        switch (opt) {
+        case 'q': queue = optarg; break;
+        case 't': topology = optarg; break;
+        case 'p': producers = atoi(optarg); break;
+        case 'c': consumers = atoi(optarg); break;
+        case 's': base.payload = atoi(optarg); break;
+        case 'n': base.count = strtoull(optarg, NULL, 10); break;
+        case 'a': base.cpus = parse_cpus(optarg); break;
+        case 'C': base.use_rdtsc = false; break;
+        default:
+            usage(argv[0]);
+            return 0;
+        }
+    }
+
+    if (producers < 1 || consumers < 1 || base.payload < 0 || 0 == base.count) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    CBenchClock::instance().set_rdtsc(base.use_rdtsc);
+    printf("clock: %s\n", CBenchClock::instance().is_rdtsc() ? "rdtsc" : "steady_clock");
+    printf("%-18s %-5s %-6s %7s %12s %10s %10s %10s %10s %12s\n",
+           "queue", "topo", "thread", "payload", "items/s", "p50(ns)", "p99(ns)", "p999(ns)", "max(ns)", "miss/item");
+
+    const char *topo_name[] = {"1p1c", "np1c", "npmc"};
+    for (int t = TOPO_1P1C; t <= TOPO_NPMC; ++t) {
+        if (topology != "all" && topology != topo_name[t]) {
+            continue;
+        }
+
+        BenchConfig cfg = base;
+        cfg.topology = t;
+        cfg.producers = (TOPO_1P1C == t) ? 1 : producers;
+        cfg.consumers = (TOPO_NPMC == t) ? consumers : 1;
+
+        for (size_t i = 0; i < sizeof(g_cases) / sizeof(g_cases[0]); ++i) {
+            if (queue != "all" && queue != g_cases[i].name) {
+                continue;
+            }
+
+            BenchResult result;
+            if (!g_cases[i].func(cfg, result)) {
+                continue;   // 单生产者/单消费者组件不支持该拓扑
+            }
+            bench_report(g_cases[i].name, cfg, result);
+        }
+    }
+
+    return 0;
+}
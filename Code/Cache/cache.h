@@ -36,7 +36,8 @@ public:
         {}
     };
 
-    Cache();
+    // service不为空时过期清理在定时服务的线程上执行
+    explicit Cache(CTimerService * service = nullptr);
     Cache(const Cache&) = delete;
     Cache & operator=(const Cache&) = delete;
     ~Cache();
@@ -62,7 +63,7 @@ private:
 };
 
 template <typename V>
-Cache<V>::Cache() {
+Cache<V>::Cache(CTimerService * service) : m_timer(service) {
     pthread_rwlock_init(&m_lock, nullptr);
     m_timer.start(1000, std::bind(clean_expire, this));
 }
@@ -30,6 +30,15 @@ int main()
     pCache->del(strKeyId);
     std::cout << pCache->print();
 
+    // 多个Cache共用一个定时服务线程做过期清理
+    CTimerService service(1, CThreadOptions("cache_timer"));
+    CacheUINT64 cache1(&service);
+    CacheUINT64 cache2(&service);
+    cache1.set(strKeyId, 1, 1);
+    cache2.set(strKeyId, 2, 1);
+    sleep(3);
+    std::cout << cache1.print() << cache2.print();
+
     return 0;
 }
 
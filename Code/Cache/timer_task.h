@@ -5,11 +5,13 @@
 #include <atomic>
 #include <chrono>
 #include <functional>
+#include "timer_service.h"
 
 
+// 构造时传入CTimerService则任务在定时服务的线程上执行, 不创建线程
 class TimerTask {
 public:
-    TimerTask() : _execute(false)
+    explicit TimerTask(CTimerService * service = nullptr) : _execute(false), _service(service), _job_id(0)
     {}
 
     ~TimerTask() {
@@ -19,6 +21,10 @@ public:
 
     void stop() {
         _execute.store(false, std::memory_order_release);
+        if (_service && _job_id > 0) {
+            _service->cancel(_job_id);
+            _job_id = 0;
+        }
         if (_thd.joinable())
             _thd.join();
     }
@@ -28,6 +34,10 @@ public:
             stop();
         }
         _execute.store(true, std::memory_order_release);
+        if (_service) {
+            _job_id = _service->schedule_with_fixed_delay(task, interval_ms, true);
+            return;
+        }
         _thd = std::thread([this, interval_ms, task]() {
                     while (_execute.load(std::memory_order_acquire)) {
                         task();
@@ -37,12 +47,14 @@ public:
     }
 
     bool is_running() const noexcept {
-        return (_execute.load(std::memory_order_acquire) && _thd.joinable());
+        return (_execute.load(std::memory_order_acquire) && (_thd.joinable() || _job_id > 0));
     }
 
 private:
     std::atomic<bool> _execute;
     std::thread _thd;
+    CTimerService * _service;
+    uint64_t _job_id;
 };
 
 #endif
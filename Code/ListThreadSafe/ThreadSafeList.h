@@ -1,16 +1,25 @@
 #ifndef BLOCK_LIST_H_
 #define BLOCK_LIST_H_
-#include <list>
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
 
+#include "ChunkList.h"
+
 const int TYPE_BLOCK = 1;
 const int TYPE_NOT_BLOCK = 2;
 
 
+// 元素存放在CChunkList中, chunk的分配和释放都在锁外进行
 template <typename T>
 class CThreadSafeList
 {
+    typedef CChunkList<T> Storage;
+    typedef typename Storage::Chunk Chunk;
+
 public:
     CThreadSafeList(): m_stop(false), m_size(0) {
     }
@@ -23,9 +32,20 @@ public:
     bool is_stop() {
         return m_stop;
     }
-    void push_back(T & a) {
+    void push_back(const T & a) {
+        emplace_back(a);
+    }
+
+    void push_back(T && a) {
+        emplace_back(std::move(a));
+    }
+
+    // 在队尾直接构造元素
+    template <typename... Args>
+    void emplace_back(Args &&... args) {
         std::unique_lock<std::mutex> lck(m_mutex);
-        m_list.push_back(a);
+        reserve(lck);
+        m_list.emplace_back(std::forward<Args>(args)...);
         ++m_size;
         m_cond.notify_one();
     }
@@ -38,12 +58,151 @@ public:
         return getWithBlock(a);
     }
 
+    // 最多等待timeout_ms, 超时或停止返回false
+    bool pop_front_for(T & a, int timeout_ms) {
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        std::unique_lock<std::mutex> lck(m_mutex);
+        while (m_list.empty()) {
+            if (m_stop) {
+                return false;
+            }
+            if (std::cv_status::timeout == m_cond.wait_until(lck, deadline) && m_list.empty()) {
+                return false;
+            }
+        }
+        Chunk * garbage = pop_locked(a);
+        lck.unlock();
+
+        Storage::free_chunks(garbage);
+        return true;
+    }
+
     size_t size() {
         return m_size;
     }
 
+    // 一次加锁取走最多max个元素(max为0时全部取走), 不阻塞, 返回取到的个数
+    size_t take_all(std::vector<T> & out, size_t max = 0) {
+        out.reserve(out.size() + (max > 0 ? max : Storage::CHUNK_NODES));
+
+        Storage batch;
+        std::unique_lock<std::mutex> lck(m_mutex);
+        size_t count = take_front(batch, out, max);
+        Chunk * garbage = m_list.release_garbage();
+        lck.unlock();
+
+        Storage::free_chunks(garbage);
+        return count + move_out(batch, out);
+    }
+
+    // 阻塞直到有数据, 每次唤醒取走一批; 停止且为空或超时返回false, 调用方用is_stop()区分
+    // timeout_ms不小于0时最多等待timeout_ms
+    bool wait_and_drain(std::vector<T> & out, size_t max = 0, int timeout_ms = -1) {
+        out.reserve(out.size() + (max > 0 ? max : Storage::CHUNK_NODES));
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+        Storage batch;
+        std::unique_lock<std::mutex> lck(m_mutex);
+        while (m_list.empty()) {
+            if (m_stop) {
+                return false;
+            }
+            if (timeout_ms < 0) {
+                m_cond.wait(lck);
+            } else if (std::cv_status::timeout == m_cond.wait_until(lck, deadline) && m_list.empty()) {
+                return false;
+            }
+        }
+        take_front(batch, out, max);
+        Chunk * garbage = m_list.release_garbage();
+        lck.unlock();
+
+        Storage::free_chunks(garbage);
+        move_out(batch, out);
+        return true;
+    }
+
+    // chunk在锁外构造, 加锁后整体拼接到队尾
+    template <typename Iter>
+    void put_all(Iter first, Iter last) {
+        Storage batch;
+        for (; first != last; ++first) {
+            batch.emplace_back(*first);
+        }
+        if (batch.empty()) {
+            return;
+        }
+
+        size_t count = batch.size();
+        std::unique_lock<std::mutex> lck(m_mutex);
+        m_list.append(batch);
+        m_size += count;
+        if (count > 1) {
+            m_cond.notify_all();
+        } else {
+            m_cond.notify_one();
+        }
+        Chunk * garbage = m_list.release_garbage();
+        lck.unlock();
+
+        Storage::free_chunks(garbage);
+    }
+
+    template <typename Container>
+    void put_all(const Container & items) {
+        put_all(items.begin(), items.end());
+    }
+
 
 protected:
+    // 调用者持锁; 队尾chunk已满且没有空闲chunk时, 解锁分配后再加锁
+    void reserve(std::unique_lock<std::mutex> & lck) {
+        while (!m_list.has_room()) {
+            lck.unlock();
+            Chunk * chunk = Storage::alloc_chunk();
+            lck.lock();
+            m_list.add_spare(chunk);
+        }
+    }
+
+    // 调用者持锁, 返回直接移到out的个数(out已预留空间)
+    // 全部取走且超过一个chunk时整条chunk链转给batch, 否则逐个移动, 避免chunk被带出后push重新分配
+    size_t take_front(Storage & batch, std::vector<T> & out, size_t max) {
+        if (0 == max && m_list.size() > Storage::CHUNK_NODES) {
+            m_size -= m_list.size();
+            m_list.steal_all(batch);
+            return 0;
+        }
+
+        size_t limit = (0 == max || max > m_list.size()) ? m_list.size() : max;
+        size_t count = 0;
+        for (; count < limit; ++count) {
+            out.push_back(std::move(m_list.front()));
+            m_list.pop_front();
+        }
+        m_size -= count;
+        return count;
+    }
+
+    // 锁外把batch中的元素移动到out
+    static size_t move_out(Storage & batch, std::vector<T> & out) {
+        size_t count = batch.size();
+        out.reserve(out.size() + count);
+        while (!batch.empty()) {
+            out.push_back(std::move(batch.front()));
+            batch.pop_front();
+        }
+        return count;
+    }
+
+    // 调用者持锁, 取出队头元素并返回需要在锁外释放的chunk
+    Chunk * pop_locked(T & a) {
+        a = std::move(m_list.front());
+        m_list.pop_front();
+        --m_size;
+        return m_list.release_garbage();
+    }
+
     bool getWithoutBlock(T & a) {
         std::unique_lock<std::mutex> lck(m_mutex, std::defer_lock);
         if (!lck.try_lock()) {
@@ -53,9 +212,10 @@ protected:
         if (m_list.empty()) {
             return false;
         }
-        a = m_list.front();
-        m_list.pop_front();
+        Chunk * garbage = pop_locked(a);
+        lck.unlock();
 
+        Storage::free_chunks(garbage);
         return true;
     }
 
@@ -68,10 +228,10 @@ protected:
 
             m_cond.wait(lck);
         }
-        a = m_list.front();
-        m_list.pop_front();
-        --m_size;
+        Chunk * garbage = pop_locked(a);
+        lck.unlock();
 
+        Storage::free_chunks(garbage);
         return true;
     }
 
@@ -81,8 +241,8 @@ private:
 
     std::mutex m_mutex;
     std::condition_variable m_cond;
-    std::list<T> m_list;
-    uint64_t m_size;
+    Storage m_list;
+    std::atomic<uint64_t> m_size;  // size()不加锁读取
 };
 
 #endif
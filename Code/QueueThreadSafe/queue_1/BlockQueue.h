@@ -2,6 +2,10 @@
 #define BLOCK_QUEUE_H_
 
 #include <deque>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <utility>
 
 #include "Mutex.h"
 #include "Condition.h"
@@ -10,42 +14,255 @@
 template<typename T>
 class CBlockQueue {
 public:
-    CBlockQueue()
+    // capacity为0时不限制长度
+    explicit CBlockQueue(size_t capacity = 0)
         : m_queue(),
         m_mutex(),
-        m_cond(m_mutex)
+        m_not_empty(m_mutex),
+        m_not_full(m_mutex),
+        m_capacity(capacity)
     {}
 
+    // 队列满时阻塞
     void put(const T & x) {
         CMutexGuard lock(m_mutex);
-        m_queue.push_back(x);
-        m_cond.notify();
+        while (is_full()) {
+            m_not_full.wait();
+        }
+
+        push(x);
+    }
+
+    void put(T && x) {
+        CMutexGuard lock(m_mutex);
+        while (is_full()) {
+            m_not_full.wait();
+        }
+
+        push(std::move(x));
+    }
+
+    // 在队尾直接构造元素, 队列满时阻塞
+    template <typename... Args>
+    void emplace(Args &&... args) {
+        CMutexGuard lock(m_mutex);
+        while (is_full()) {
+            m_not_full.wait();
+        }
+
+        m_queue.emplace_back(std::forward<Args>(args)...);
+        m_not_empty.notify();
+    }
+
+    // 队列满时立即返回false
+    bool try_put(const T & x) {
+        CMutexGuard lock(m_mutex);
+        if (is_full()) {
+            return false;
+        }
+
+        push(x);
+        return true;
+    }
+
+    bool try_put(T && x) {
+        CMutexGuard lock(m_mutex);
+        if (is_full()) {
+            return false;
+        }
+
+        push(std::move(x));
+        return true;
+    }
+
+    // 队列满时最多等待timeout_ms, 超时返回false
+    bool put_for(const T & x, int timeout_ms) {
+        struct timespec abstime = CCondition::deadline(timeout_ms);
+
+        CMutexGuard lock(m_mutex);
+        while (is_full()) {
+            if (!m_not_full.wait_until(abstime) && is_full()) {
+                return false;
+            }
+        }
+
+        push(x);
+        return true;
+    }
+
+    bool put_for(T && x, int timeout_ms) {
+        struct timespec abstime = CCondition::deadline(timeout_ms);
+
+        CMutexGuard lock(m_mutex);
+        while (is_full()) {
+            if (!m_not_full.wait_until(abstime) && is_full()) {
+                return false;
+            }
+        }
+
+        push(std::move(x));
+        return true;
     }
 
     T take() {
         CMutexGuard lock(m_mutex);
         while (m_queue.empty()) {
-            m_cond.wait();
+            m_not_empty.wait();
         }
 
-        T front(m_queue.front());
-        m_queue.pop_front();
+        T front(std::move(m_queue.front()));
+        pop();
         return front;
     }
 
+    // 队列空时立即返回false
+    bool try_take(T & x) {
+        CMutexGuard lock(m_mutex);
+        if (m_queue.empty()) {
+            return false;
+        }
+
+        x = std::move(m_queue.front());
+        pop();
+        return true;
+    }
+
+    // 队列空时最多等待timeout_ms, 超时返回false
+    bool take_for(T & x, int timeout_ms) {
+        struct timespec abstime = CCondition::deadline(timeout_ms);
+
+        CMutexGuard lock(m_mutex);
+        while (m_queue.empty()) {
+            if (!m_not_empty.wait_until(abstime) && m_queue.empty()) {
+                return false;
+            }
+        }
+
+        x = std::move(m_queue.front());
+        pop();
+        return true;
+    }
+
     size_t size() {
         CMutexGuard lock(m_mutex);
         return m_queue.size();
     }
 
+    size_t capacity() const {
+        return m_capacity;
+    }
+
+    // 一次加锁取走最多max个元素(max为0时全部取走), 不阻塞, 返回取到的个数
+    size_t take_all(std::vector<T> & out, size_t max = 0) {
+        std::deque<T> batch;
+        {
+            CMutexGuard lock(m_mutex);
+            drain(batch, max);
+        }
+
+        return move_out(batch, out);
+    }
+
+    // 阻塞直到有数据, 每次唤醒取走一批; timeout_ms小于0时一直等待, 超时返回false
+    // 与CThreadSafeList::wait_and_drain的约定一致, 取到的个数由out.size()得到
+    bool wait_and_drain(std::vector<T> & out, size_t max = 0, int timeout_ms = -1) {
+        std::deque<T> batch;
+        {
+            struct timespec abstime = CCondition::deadline(timeout_ms < 0 ? 0 : timeout_ms);
+
+            CMutexGuard lock(m_mutex);
+            while (m_queue.empty()) {
+                if (timeout_ms < 0) {
+                    m_not_empty.wait();
+                } else if (!m_not_empty.wait_until(abstime) && m_queue.empty()) {
+                    return false;
+                }
+            }
+            drain(batch, max);
+        }
+
+        move_out(batch, out);
+        return true;
+    }
+
+    // 一次加锁放入整批; 有长度限制时按剩余空间分批放入, 空间不足时阻塞
+    template <typename Iter>
+    void put_all(Iter first, Iter last) {
+        CMutexGuard lock(m_mutex);
+        while (first != last) {
+            while (is_full()) {
+                m_not_full.wait();
+            }
+
+            size_t count = 0;
+            for (; first != last && !is_full(); ++first, ++count) {
+                m_queue.push_back(*first);
+            }
+
+            if (count > 1) {
+                m_not_empty.notify_all();
+            } else {
+                m_not_empty.notify();
+            }
+        }
+    }
+
+    template <typename Container>
+    void put_all(const Container & items) {
+        put_all(items.begin(), items.end());
+    }
+
 private:
     CBlockQueue(const CBlockQueue &);
     void operator=(const CBlockQueue &);
 
+    // 调用者持锁, 把队头最多max个元素转移到batch
+    void drain(std::deque<T> & batch, size_t max) {
+        if (0 == max || max >= m_queue.size()) {
+            batch.swap(m_queue);
+        } else {
+            typename std::deque<T>::iterator end = m_queue.begin() + max;
+            std::move(m_queue.begin(), end, std::back_inserter(batch));
+            m_queue.erase(m_queue.begin(), end);
+        }
+
+        if (m_capacity > 0 && !batch.empty()) {
+            m_not_full.notify_all();
+        }
+    }
+
+    // 锁外把batch中的元素移动到out
+    static size_t move_out(std::deque<T> & batch, std::vector<T> & out) {
+        size_t count = batch.size();
+        out.reserve(out.size() + count);
+        for (typename std::deque<T>::iterator it = batch.begin(); it != batch.end(); ++it) {
+            out.push_back(std::move(*it));
+        }
+        return count;
+    }
+
+    bool is_full() const {
+        return m_capacity > 0 && m_queue.size() >= m_capacity;
+    }
+
+    template <typename U>
+    void push(U && x) {
+        m_queue.push_back(std::forward<U>(x));
+        m_not_empty.notify();
+    }
+
+    void pop() {
+        m_queue.pop_front();
+        if (m_capacity > 0) {
+            m_not_full.notify();
+        }
+    }
+
     std::deque<T> m_queue;
     CMutex m_mutex;
-    CCondition m_cond;
+    CCondition m_not_empty;
+    CCondition m_not_full;
+    size_t m_capacity;
 };
 
 #endif // BLOCK_QUEUE_H_
-
@@ -1,6 +1,9 @@
 #ifndef CONDITION_H_
 #define CONDITION_H_
 
+#include <errno.h>
+#include <time.h>
+
 #include "Mutex.h"
 
 
@@ -9,7 +12,12 @@ public:
     explicit CCondition(CMutex & mutex)
         : m_mutex(mutex)
     {
-        pthread_cond_init(&m_pcond, NULL);
+        // 超时等待使用单调时钟, 不受系统时间调整影响
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&m_pcond, &attr);
+        pthread_condattr_destroy(&attr);
     }
 
     ~CCondition() {
@@ -20,6 +28,11 @@ public:
         pthread_cond_wait(&m_pcond, m_mutex.get_mutex());
     }
 
+    // 超时返回false
+    bool wait_until(const struct timespec & abstime) {
+        return ETIMEDOUT != pthread_cond_timedwait(&m_pcond, m_mutex.get_mutex(), &abstime);
+    }
+
     void notify() {
         pthread_cond_signal(&m_pcond);
     }
@@ -28,6 +41,23 @@ public:
          pthread_cond_broadcast(&m_pcond);
     }
 
+    // 当前时间之后timeout_ms的绝对时间, 用于wait_until; 负数按0处理(立即超时), 与queue_2的wait_for一致
+    static struct timespec deadline(int timeout_ms) {
+        if (timeout_ms < 0) {
+            timeout_ms = 0;
+        }
+
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_sec += timeout_ms / 1000;
+        ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec += 1;
+            ts.tv_nsec -= 1000000000;
+        }
+        return ts;
+    }
+
 private:
     CCondition(const CCondition &);
     void operator=(const CCondition &);
@@ -38,4 +68,3 @@ private:
 
 
 #endif // CONTION_H_
-
@@ -24,7 +24,7 @@ void *TH_Recv(void *queue);
 
 int main()
 {
-    CBlockQueue<BlockTest> queue;
+    CBlockQueue<BlockTest> queue(16);    // 队列满时生产者阻塞
     
     pthread_t thSendThread;
     int iRet = pthread_create(&thSendThread, NULL, &TH_Send, &queue);
@@ -44,6 +44,49 @@ int main()
     pthread_join(thSendThread, NULL);
     pthread_join(thRecvThread, NULL);
 
+    // 原地构造: emplace直接在队尾构造元素, 不产生临时对象
+    {
+        CBlockQueue<std::pair<int, string>> pairQueue;
+        pairQueue.emplace(1, "emplace");
+        std::pair<int, string> item(pairQueue.take());
+        printf("emplace take: %d %s\n", item.first, item.second.c_str());
+    }
+
+    // 有界: 队列满时try_put立即失败, put_for等待超时; 队列空时take_for等待超时
+    {
+        CBlockQueue<int> boundQueue(2);
+        int iFull = 0;
+        for (int i=0; i<3; ++i) {
+            if (!boundQueue.try_put(i)) {
+                ++iFull;
+            }
+        }
+        bool bPutTimeout = !boundQueue.put_for(3, 10);
+
+        int iValue = 0;
+        int iTaken = 0;
+        while (boundQueue.take_for(iValue, 10)) {
+            ++iTaken;
+        }
+        printf("bounded try_put full: %d, put_for timeout: %d, take_for taken: %d\n", iFull, bPutTimeout, iTaken);
+    }
+
+    // 批量: 一次加锁放入/取走整批; 队列为空时wait_and_drain超时返回false
+    {
+        CBlockQueue<int> batchQueue;
+        std::vector<int> vecIn;
+        for (int i=0; i<10; ++i) {
+            vecIn.push_back(i);
+        }
+        batchQueue.put_all(vecIn);
+
+        std::vector<int> vecOut;
+        size_t count = batchQueue.take_all(vecOut, 4);
+        bool bDrain = batchQueue.wait_and_drain(vecOut, 0, 10);
+        bool bTimeout = !batchQueue.wait_and_drain(vecOut, 0, 10);
+        printf("batch take_all: %zu, drain: %d, total: %zu, timeout: %d\n", count, bDrain, vecOut.size(), bTimeout);
+    }
+
     return 0;
 }
 
@@ -1,8 +1,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <chrono>
+#include <thread>
+#include <vector>
 #include "RingBuf.h"
 
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT		26
+#endif
+
+#define HUGE_2M_SHIFT		21
+#define HUGE_1G_SHIFT		30
+
 
 CRingBuf::CRingBuf()
 {
@@ -11,13 +25,25 @@ CRingBuf::CRingBuf()
 	m_nWrPos = 0;
 	m_nRdPos = 0;
 	m_uDropCount = 0;
+	m_nMemType = RING_MEM_MALLOC;
+	m_nMapSize = 0;
+	m_nPolicy = RING_OVERFLOW_REJECT;
+	m_nBlockTimeoutMs = 0;
+	m_pSpill = NULL;
 }
 
 CRingBuf::~CRingBuf()
 {
 	if (m_pData)
 	{
-		free(m_pData);
+		if (RING_MEM_MALLOC == m_nMemType)
+		{
+			free(m_pData);
+		}
+		else
+		{
+			munmap(m_pData, m_nMapSize);
+		}
 	}	
 }
 
@@ -38,24 +64,277 @@ bool CRingBuf::Init(unsigned int nSize)
 	m_nSize = nSize;
 	m_nWrPos = 0;
 	m_nRdPos = 0;
+	m_nMemType = RING_MEM_MALLOC;
+	m_nMapSize = 0;
+
+	return true;
+}
+
+bool CRingBuf::Init(unsigned int nSize, int nAllocFlag, int nPrefaultThreads)
+{
+	if(NULL != m_pData || 0 == nSize)
+	{
+		return false;
+	}
+
+	if (RING_ALLOC_DEFAULT == (nAllocFlag & (RING_ALLOC_HUGE_2M | RING_ALLOC_HUGE_1G | RING_ALLOC_THP | RING_ALLOC_MLOCK)))
+	{
+		if (!Init(nSize))
+		{
+			return false;
+		}
+
+		if (nAllocFlag & RING_ALLOC_PREFAULT)
+		{
+			Prefault(m_pData, m_nSize, sysconf(_SC_PAGESIZE), nPrefaultThreads);
+		}
+		return true;
+	}
+
+	char *pData = NULL;
+	size_t nMapSize = nSize;
+	size_t nPageSize = sysconf(_SC_PAGESIZE);
+	int nMemType = RING_MEM_MMAP;
+
+	//ҳλ: 1GB -> 2MB -> ͨҳ
+	if (nAllocFlag & RING_ALLOC_HUGE_1G)
+	{
+		nMapSize = nSize;
+		pData = MapHuge(nMapSize, HUGE_1G_SHIFT);
+		nMemType = RING_MEM_HUGE_1G;
+		nPageSize = 1UL << HUGE_1G_SHIFT;
+	}
+
+	if (NULL == pData && (nAllocFlag & (RING_ALLOC_HUGE_1G | RING_ALLOC_HUGE_2M)))
+	{
+		nMapSize = nSize;
+		pData = MapHuge(nMapSize, HUGE_2M_SHIFT);
+		nMemType = RING_MEM_HUGE_2M;
+		nPageSize = 1UL << HUGE_2M_SHIFT;
+	}
+
+	if (NULL == pData)
+	{
+		if (nAllocFlag & (RING_ALLOC_HUGE_1G | RING_ALLOC_HUGE_2M))
+		{
+			printf("CRingBuf::Init hugetlb unavailable, fallback to normal pages\n");
+		}
+
+		nPageSize = sysconf(_SC_PAGESIZE);
+		nMapSize = (nSize + nPageSize - 1) & ~(nPageSize - 1);
+		pData = (char *)mmap(NULL, nMapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (MAP_FAILED == pData)
+		{
+			printf("CRingBuf::Init mmap failed %u Bytes: %s\n", nSize, strerror(errno));
+			return false;
+		}
+		nMemType = RING_MEM_MMAP;
+
+		//˵ͨҳʱͬ͸ҳ
+		if ((nAllocFlag & (RING_ALLOC_THP | RING_ALLOC_HUGE_1G | RING_ALLOC_HUGE_2M)) && 0 != madvise(pData, nMapSize, MADV_HUGEPAGE))
+		{
+			printf("CRingBuf::Init madvise(MADV_HUGEPAGE) failed: %s\n", strerror(errno));
+		}
+	}
+
+	bool bLocked = false;
+	if (nAllocFlag & RING_ALLOC_MLOCK)
+	{
+		bLocked = (0 == mlock(pData, nMapSize));
+		if (!bLocked)
+		{
+			printf("CRingBuf::Init mlock failed %lu Bytes: %s, prefault instead\n", (unsigned long)nMapSize, strerror(errno));
+		}
+	}
+
+	m_pData = pData;
+	m_nSize = nSize;
+	m_nWrPos = 0;
+	m_nRdPos = 0;
+	m_nMemType = nMemType;
+	m_nMapSize = nMapSize;
+
+	//mlockɹʱѾȱҳ, Ԥȱҳ; mlockʧ(EPERM/RLIMIT_MEMLOCK)ʱٱ֤ҳѷ
+	if ((nAllocFlag & (RING_ALLOC_PREFAULT | RING_ALLOC_MLOCK)) && !bLocked)
+	{
+		Prefault(m_pData, m_nMapSize, nPageSize, nPrefaultThreads);
+	}
 
 	return true;
 }
 
+char *CRingBuf::MapHuge(size_t& nMapSize, int nPageShift)
+{
+	size_t nPageSize = 1UL << nPageShift;
+	nMapSize = (nMapSize + nPageSize - 1) & ~(nPageSize - 1);
+
+	int nFlag = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (nPageShift << MAP_HUGE_SHIFT);
+	void *pData = mmap(NULL, nMapSize, PROT_READ | PROT_WRITE, nFlag, -1, 0);
+	if (MAP_FAILED == pData)
+	{
+		return NULL;
+	}
+
+	return (char *)pData;
+}
+
+void CRingBuf::Prefault(char *pData, size_t nSize, size_t nPageSize, int nThreads)
+{
+	if (nThreads <= 1)
+	{
+		for (size_t i = 0; i < nSize; i += nPageSize)
+		{
+			pData[i] = 0;
+		}
+		return;
+	}
+
+	//ҳָ߳, дȱҳ
+	size_t nPages = (nSize + nPageSize - 1) / nPageSize;
+	size_t nPerThread = (nPages + nThreads - 1) / nThreads;
+
+	std::vector<std::thread> vecThread;
+	for (int t = 0; t < nThreads; ++t)
+	{
+		size_t nBegin = t * nPerThread * nPageSize;
+		size_t nEnd = nBegin + nPerThread * nPageSize;
+		if (nBegin >= nSize)
+		{
+			break;
+		}
+		if (nEnd > nSize)
+		{
+			nEnd = nSize;
+		}
+
+		vecThread.push_back(std::thread([pData, nBegin, nEnd, nPageSize]() {
+			for (size_t i = nBegin; i < nEnd; i += nPageSize)
+			{
+				pData[i] = 0;
+			}
+		}));
+	}
+
+	for (size_t i = 0; i < vecThread.size(); ++i)
+	{
+		vecThread[i].join();
+	}
+}
+
 void CRingBuf::Clear()
 {
     m_nWrPos = 0;
     m_nRdPos = 0;
 }
 
+bool CRingBuf::SetOverflowPolicy(int nPolicy, int nBlockTimeoutMs, CRingBuf *pSpill)
+{
+	if (RING_OVERFLOW_OVERWRITE == nPolicy || (RING_OVERFLOW_SPILL == nPolicy && (NULL == pSpill || this == pSpill)))
+	{
+		printf("CRingBuf::SetOverflowPolicy unsupported policy %d\n", nPolicy);
+		return false;
+	}
+
+	m_nPolicy = nPolicy;
+	m_nBlockTimeoutMs = nBlockTimeoutMs;
+	m_pSpill = pSpill;
+
+	return true;
+}
+
+void CRingBuf::SetReportInterval(int nIntervalMs)
+{
+	m_log.SetInterval(nIntervalMs);
+}
+
+bool CRingBuf::Contains(const char *pData) const
+{
+	return NULL != pData && NULL != m_pData && pData >= m_pData && pData <= m_pData + m_nSize;
+}
+
 char* CRingBuf::Write(char* pData,unsigned int nLen)
 {
-	char *pRet = NULL;
 	if(NULL == pData || 0 == nLen)
+		return NULL;
+
+	char *pRet = TryWrite(pData, nLen);
+	if (NULL == pRet && RING_OVERFLOW_BLOCK == m_nPolicy)
+	{
+		pRet = WaitWrite(pData, nLen);
+	}
+
+	if (NULL != pRet)
+	{
+		m_stat.OnWrite(UsedBytes());
 		return pRet;
+	}
 
+	if (RING_OVERFLOW_SPILL == m_nPolicy)
+	{
+		pRet = m_pSpill->Write(pData, nLen);
+		if (NULL != pRet)
+		{
+			return pRet;
+		}
+	}
+
+	__atomic_fetch_add(&m_uDropCount, 1, __ATOMIC_RELAXED);
+	m_stat.OnDrop();
+
+	//дʱÿ, Ƶ
+	uint64_t ullSuppressed = 0;
+	if (m_log.ShouldReport(ullSuppressed))
+	{
+		printf("CRingBuf::Write() err: no buf for fill data <Wr:%u, Rd:%u, InputSize=%u, Suppressed=%lu>\n",
+			m_nWrPos, m_nRdPos, nLen, (unsigned long)ullSuppressed);
+	}
+
+	return NULL;
+}
+
+char* CRingBuf::WaitWrite(char* pData, unsigned int nLen)
+{
+	std::chrono::steady_clock::time_point tpDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_nBlockTimeoutMs);
+
+	//óCPUSetRead, ޿ռٶ
+	for (int i = 0; ; ++i)
+	{
+		if (i < 64)
+		{
+			sched_yield();
+		}
+		else
+		{
+			usleep(50);
+		}
+
+		char *pRet = TryWrite(pData, nLen);
+		if (NULL != pRet)
+		{
+			return pRet;
+		}
+
+		if (std::chrono::steady_clock::now() >= tpDeadline)
+		{
+			return NULL;
+		}
+	}
+}
+
+unsigned int CRingBuf::UsedBytes()
+{
 	unsigned int nWr = m_nWrPos;
-	unsigned int nRd = m_nRdPos;
+	unsigned int nRd = __atomic_load_n(&m_nRdPos, __ATOMIC_RELAXED);
+
+	return (nWr - nRd + m_nSize) % m_nSize;
+}
+
+char* CRingBuf::TryWrite(char* pData,unsigned int nLen)
+{
+	char *pRet = NULL;
+
+	unsigned int nWr = m_nWrPos;
+	unsigned int nRd = __atomic_load_n(&m_nRdPos, __ATOMIC_ACQUIRE);
 	unsigned int nTmpLen = nLen + 1;		//һ'\0'
 	if(m_nSize - nWr > nTmpLen)
 	{
@@ -78,13 +357,7 @@ char* CRingBuf::Write(char* pData,unsigned int nLen)
 		}
 	}
 
-	m_nWrPos = nWr;
-
-	if (NULL == pRet)
-	{
-		++m_uDropCount;
-		printf("CRingBuf::Write() err: no buf for fill data <Wr:%d, Rd:%d, InputSize=%d>\n", m_nWrPos, m_nRdPos, nLen);
-	}
+	__atomic_store_n(&m_nWrPos, nWr, __ATOMIC_RELEASE);
 
 	return pRet;
 }
@@ -102,7 +375,7 @@ bool CRingBuf::SetRead(char* pData)
 		return false;
 	}
 
-	m_nRdPos = (unsigned int)(pData - m_pData);
+	__atomic_store_n(&m_nRdPos, (unsigned int)(pData - m_pData), __ATOMIC_RELEASE);
 
 	return true;
 }
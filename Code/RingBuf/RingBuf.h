@@ -1,9 +1,31 @@
 #ifndef _TCP_RING_H_
 #define _TCP_RING_H_
 
+#include <stddef.h>
+#include "RingStat.h"
 
 #define MAX_RING_SIZE		1024 * 1024 * 500
 
+//Initڴѡ, ʹ
+enum RING_ALLOC_FLAG
+{
+	RING_ALLOC_DEFAULT	= 0x00,		//malloc
+	RING_ALLOC_HUGE_2M	= 0x01,		//MAP_HUGETLB 2MBҳ, ʧʱ˵ͨҳ
+	RING_ALLOC_HUGE_1G	= 0x02,		//MAP_HUGETLB 1GBҳ, ʧʱλ˵2MB/ͨҳ
+	RING_ALLOC_THP		= 0x04,		//ͨҳӳmadvise(MADV_HUGEPAGE)
+	RING_ALLOC_MLOCK	= 0x08,		//mlock, ֹ
+	RING_ALLOC_PREFAULT	= 0x10,		//InitʱԤȴȱҳ
+};
+
+//ʵʹõڴ
+enum RING_MEM_TYPE
+{
+	RING_MEM_MALLOC		= 0,
+	RING_MEM_MMAP		= 1,
+	RING_MEM_HUGE_2M	= 2,
+	RING_MEM_HUGE_1G	= 3,
+};
+
 
 class CRingBuf
 {
@@ -15,11 +37,25 @@ public:
 	//ʼ
 	bool Init(unsigned int nSize = MAX_RING_SIZE);
 
+	//RING_ALLOC_FLAG, nPrefaultThreadsΪԤȱҳ߳(0Ϊ߳)
+	bool Init(unsigned int nSize, int nAllocFlag, int nPrefaultThreads = 0);
+
     void Clear();
 
-	//д
+	//д, дʱԴ
 	char *Write(char *pData, unsigned int nLen);
 
+	//; BLOCKʱȴnBlockTimeoutMs, SPILLʱдpSpill(pSpillSetRead)
+	//Writeصǻڵָ, ޷ȫ, ֧RING_OVERFLOW_OVERWRITE
+	bool SetOverflowPolicy(int nPolicy, int nBlockTimeoutMs = 10, CRingBuf *pSpill = NULL);
+
+	//־С
+	void SetReportInterval(int nIntervalMs);
+
+	const CRingDropStat& GetStat() const { return m_stat; }
+
+	bool Contains(const char *pData) const;
+
 	//öλ
 	bool SetRead(char *pData);
 
@@ -34,7 +70,24 @@ public:
 	unsigned int m_nSize;
 
 	unsigned int m_uDropCount;
-	
+
+	int m_nMemType;
+	size_t m_nMapSize;
+
+private:
+	char *TryWrite(char *pData, unsigned int nLen);
+	char *WaitWrite(char *pData, unsigned int nLen);
+	unsigned int UsedBytes();
+
+	int m_nPolicy;
+	int m_nBlockTimeoutMs;
+	CRingBuf *m_pSpill;
+
+	CRingDropStat m_stat;
+	CRateLimitedLog m_log;
+
+	static char *MapHuge(size_t& nMapSize, int nPageShift);
+	static void Prefault(char *pData, size_t nSize, size_t nPageSize, int nThreads);
 };
 #endif
 
@@ -4,6 +4,13 @@
 #include <vector>
 #include <string>
 #include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <type_traits>
+
+#include "WaitStrategy.h"
+#include "RingStat.h"
 
 #ifdef LogN
 #define Log	LogN(80)
@@ -30,6 +37,11 @@ public:
 
 		m_nWrite = 1;
 		m_nRead = 0;
+		m_pWait = NULL;
+
+		m_nPolicy = RING_OVERFLOW_REJECT;
+		m_nBlockTimeoutMs = 0;
+		m_pSpill = NULL;
 	};
 
 	virtual ~CRingBuffer()
@@ -40,18 +52,20 @@ public:
 public:
 	int GetReadPos()
 	{
-		return m_nRead;
+		return m_nRead.load(std::memory_order_relaxed);
 	}
 
 	unsigned int Size()
 	{
-		if (m_nRead < m_nWrite)
+		int nRead = m_nRead.load(std::memory_order_acquire);
+		int nWrite = m_nWrite.load(std::memory_order_acquire);
+		if (nRead < nWrite)
 		{
-			return m_nWrite - m_nRead - 1;
+			return nWrite - nRead - 1;
 		}
 		else
 		{
-			return nSize - m_nRead - 1 + m_nWrite;
+			return nSize - nRead - 1 + nWrite;
 		}
 	};
 
@@ -60,12 +74,48 @@ public:
 		m_strBufName = strBufName;
 	}
 
+	//; BLOCKʱȴnBlockTimeoutMs, SPILLʱдpSpill(ͬʱpSpill)
+	//pSpillҲʱֱӶ(pSpillΪOVERWRITEʱ), pSpillpSpill
+	//OVERWRITEֻֿ֧ƽT, ֻʹPop
+	bool SetOverflowPolicy(int nPolicy, int nBlockTimeoutMs = 10, CRingBuffer *pSpill = NULL)
+	{
+		if ((RING_OVERFLOW_OVERWRITE == nPolicy && !std::is_trivially_copyable<T>::value)
+			|| (RING_OVERFLOW_SPILL == nPolicy && (NULL == pSpill || this == pSpill)))
+		{
+			Log("RingBuffer(%s) unsupported overflow policy %d\n", m_strBufName.c_str(), nPolicy);
+			return false;
+		}
+
+		if (RING_OVERFLOW_OVERWRITE == nPolicy && m_vecSlotSeq.empty())
+		{
+			std::vector<std::atomic<unsigned int> > vecSeq(m_nBufSize);
+			m_vecSlotSeq.swap(vecSeq);
+		}
+
+		m_nPolicy = nPolicy;
+		m_nBlockTimeoutMs = nBlockTimeoutMs;
+		m_pSpill = pSpill;
+
+		return true;
+	}
+
+	//־С
+	void SetReportInterval(int nIntervalMs)
+	{
+		m_log.SetInterval(nIntervalMs);
+	}
+
+	const CRingDropStat& GetStat() const
+	{
+		return m_stat;
+	}
+
 	bool IsEmpty()
 	{
 		//һλ
-		int nRTemp = (m_nRead + 1) % m_nBufSize;
+		int nRTemp = (m_nRead.load(std::memory_order_relaxed) + 1) % m_nBufSize;
 
-		if (nRTemp == m_nWrite)
+		if (nRTemp == m_nWrite.load(std::memory_order_acquire))
 		{
 			return true;
 		}
@@ -73,11 +123,52 @@ public:
 		return false;
 	};
 
+	//ߵȴ, ΪNULLʱWaitData
+	void SetWaitStrategy(CWaitStrategy *pWait)
+	{
+		m_pWait = pWait;
+	}
+
+	//ȴݵ, nTimeoutMs < 0 һֱȴ
+	bool WaitData(int nTimeoutMs = -1)
+	{
+		if (!IsEmpty())
+		{
+			return true;
+		}
+
+		if (NULL == m_pWait)
+		{
+			return false;
+		}
+
+		return m_pWait->Wait(HasData, this, nTimeoutMs);
+	}
+
+	bool WaitPop(T& nd, int nTimeoutMs = -1)
+	{
+		if (!WaitData(nTimeoutMs))
+		{
+			return false;
+		}
+
+		return Pop(nd);
+	}
+
+	//ȫȴ, ˳ʱʹ
+	void WakeAll()
+	{
+		if (NULL != m_pWait)
+		{
+			m_pWait->NotifyAll();
+		}
+	}
+
     bool GetData(T& nd)
     {
         //һλ
-        int nRTemp = (m_nRead + 1) % m_nBufSize;
-        if (nRTemp == m_nWrite)
+        int nRTemp = (m_nRead.load(std::memory_order_relaxed) + 1) % m_nBufSize;
+        if (nRTemp == m_nWrite.load(std::memory_order_acquire))
         {
             return false;
         }
@@ -90,63 +181,93 @@ public:
     void PopData()
     {
         //һλ
-        int nRTemp = (m_nRead + 1) % m_nBufSize;
-        if (nRTemp == m_nWrite)
+        int nRTemp = (m_nRead.load(std::memory_order_relaxed) + 1) % m_nBufSize;
+        if (nRTemp == m_nWrite.load(std::memory_order_acquire))
         {
             return;
         }
 
-        m_nRead = nRTemp;
+        m_nRead.store(nRTemp, std::memory_order_release);
 
         return;
     }
 
 	T Pop()
 	{
-		//һλ
-		int nRTemp = (m_nRead + 1) % m_nBufSize;
-
 		T nd;
-		if (nRTemp != m_nWrite)
-		{
-			nd = m_pBuf[nRTemp];
-			m_nRead = nRTemp;
-		}
+		Pop(nd);
 
 		return nd;
 	};
 
 	bool Pop(T& nd)
 	{
-		//һλ
-		int nRTemp = (m_nRead + 1) % m_nBufSize;
-		if (nRTemp == m_nWrite)
+		int nRead = m_nRead.load(std::memory_order_acquire);
+		while (true)
 		{
-			return false;
+			//һλ
+			int nRTemp = (nRead + 1) % m_nBufSize;
+			if (nRTemp == m_nWrite.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+
+			if (RING_OVERFLOW_OVERWRITE != m_nPolicy)
+			{
+				nd = m_pBuf[nRTemp];
+				m_nRead.store(nRTemp, std::memory_order_release);
+				break;
+			}
+
+			//ģʽ߿ڸдλ: λ(seqlock)ȷ϶,
+			//CAS; ߶λúCASʧ, ¶ȡ
+			std::atomic<unsigned int> &seq = m_vecSlotSeq[nRTemp];
+			unsigned int uSeq = seq.load(std::memory_order_acquire);
+			nd = m_pBuf[nRTemp];
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if ((uSeq & 1) || uSeq != seq.load(std::memory_order_relaxed))
+			{
+				nRead = m_nRead.load(std::memory_order_acquire);
+				continue;
+			}
+
+			if (m_nRead.compare_exchange_strong(nRead, nRTemp, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				break;
+			}
 		}
 
-		nd = m_pBuf[nRTemp];
-		m_nRead = nRTemp;		
-
 		return true;
 	};
 
 	bool Push(const T& node)
 	{
-		//һдλ
-		int nWTemp = (m_nWrite + 1) % m_nBufSize;
+		if (TryPush(node, RING_OVERFLOW_OVERWRITE == m_nPolicy))
+		{
+			return true;
+		}
 
-		if (nWTemp != m_nRead)
+		if (RING_OVERFLOW_BLOCK == m_nPolicy && WaitPush(node))
 		{
-			m_pBuf[m_nWrite] = node;
-			m_nWrite = nWTemp;
 			return true;
 		}
-		else
+
+		//ֻдһ, pSpillԼ, A->B->Aѭʱ޵ݹ
+		if (RING_OVERFLOW_SPILL == m_nPolicy && m_pSpill->TryPush(node, RING_OVERFLOW_OVERWRITE == m_pSpill->m_nPolicy))
 		{
-			Log("Read POS = %d , Write Pos = %d RingBuffer(%s) Err: can't write\n", m_nRead, m_nWrite, m_strBufName.c_str());
-			return false;
+			return true;
+		}
+
+		m_stat.OnDrop();
+
+		//дʱÿ, Ƶ
+		uint64_t ullSuppressed = 0;
+		if (m_log.ShouldReport(ullSuppressed))
+		{
+			Log("Read POS = %d , Write Pos = %d RingBuffer(%s) Err: can't write, suppressed %lu\n",
+				m_nRead.load(), m_nWrite.load(), m_strBufName.c_str(), (unsigned long)ullSuppressed);
 		}
+		return false;
 	};
 
 	void Clear()
@@ -165,19 +286,109 @@ public:
 		}
 
 		//λ
-		int nRTemp = (m_nRead + nPos + 1) % m_nBufSize;
+		int nRTemp = (m_nRead.load(std::memory_order_relaxed) + nPos + 1) % m_nBufSize;
 
 		return m_pBuf[nRTemp];
 	};
 
+private:
+	static bool HasData(void *pContext)
+	{
+		return !((CRingBuffer *)pContext)->IsEmpty();
+	}
+
+	bool TryPush(const T& node, bool bOverwrite)
+	{
+		//һдλ
+		int nWrite = m_nWrite.load(std::memory_order_relaxed);
+		int nWTemp = (nWrite + 1) % m_nBufSize;
+
+		int nRead = m_nRead.load(std::memory_order_acquire);
+		while (nWTemp == nRead)
+		{
+			if (!bOverwrite)
+			{
+				return false;
+			}
+
+			//ɵһ, Popλ
+			if (m_nRead.compare_exchange_weak(nRead, (nRead + 1) % m_nBufSize, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				m_stat.OnDrop();
+				break;
+			}
+		}
+
+		if (bOverwrite)
+		{
+			//дڼΪ, Popļ
+			std::atomic<unsigned int> &seq = m_vecSlotSeq[nWrite];
+			unsigned int uSeq = seq.load(std::memory_order_relaxed);
+			seq.store(uSeq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			m_pBuf[nWrite] = node;
+			seq.store(uSeq + 2, std::memory_order_release);
+		}
+		else
+		{
+			m_pBuf[nWrite] = node;
+		}
+		m_nWrite.store(nWTemp, std::memory_order_release);
+		m_stat.OnWrite(Size());
+
+		if (NULL != m_pWait)
+		{
+			m_pWait->Notify();
+		}
+		return true;
+	}
+
+	bool WaitPush(const T& node)
+	{
+		std::chrono::steady_clock::time_point tpDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_nBlockTimeoutMs);
+
+		//óCPUPop, ޿ռٶ
+		for (int i = 0; ; ++i)
+		{
+			if (i < 64)
+			{
+				sched_yield();
+			}
+			else
+			{
+				usleep(50);
+			}
+
+			if (TryPush(node, false))
+			{
+				return true;
+			}
+
+			if (std::chrono::steady_clock::now() >= tpDeadline)
+			{
+				return false;
+			}
+		}
+	}
+
 private:
 	int m_nBufSize;
 	std::vector<T> m_pBuf;
 
-	int m_nWrite;
-	int m_nRead;
+	std::atomic<int> m_nWrite;		//д, acquire
+	std::atomic<int> m_nRead;		//д, acquire
 
 	std::string m_strBufName;
+
+	CWaitStrategy *m_pWait;
+
+	int m_nPolicy;
+	int m_nBlockTimeoutMs;
+	CRingBuffer *m_pSpill;
+
+	std::vector<std::atomic<unsigned int> > m_vecSlotSeq;	//ģʽÿλд
+	CRingDropStat m_stat;
+	CRateLimitedLog m_log;
 };
 #endif
 
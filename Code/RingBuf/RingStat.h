@@ -0,0 +1,136 @@
+#ifndef _RING_STAT_H_
+#define _RING_STAT_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+#define MAX_RING_PRODUCERS          64
+#define DEFAULT_REPORT_INTERVAL_MS  1000
+
+
+// 写满时的处理策略
+enum RING_OVERFLOW_POLICY {
+    RING_OVERFLOW_REJECT = 0,       // 直接丢弃新数据
+    RING_OVERFLOW_OVERWRITE = 1,    // 覆盖最旧的数据(监控/遥测类数据)
+    RING_OVERFLOW_BLOCK = 2,        // 等待空间, 超时后丢弃
+    RING_OVERFLOW_SPILL = 3,        // 写入备用缓冲区
+};
+
+
+// 按生产者线程统计写入/丢弃次数以及水位, 读取时无需停止写入
+class CRingDropStat
+{
+public:
+    CRingDropStat() : m_ullHighWater(0)
+    {
+        for (int i = 0; i < MAX_RING_PRODUCERS; ++i) {
+            m_slots[i].ullWrite.store(0, std::memory_order_relaxed);
+            m_slots[i].ullDrop.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // 当前线程的生产者编号, 首次调用时分配, 超过MAX_RING_PRODUCERS的线程共享槽位
+    static int ProducerId()
+    {
+        static std::atomic<int> s_nNextId(0);
+        static thread_local int s_nId = s_nNextId.fetch_add(1, std::memory_order_relaxed) % MAX_RING_PRODUCERS;
+        return s_nId;
+    }
+
+    void OnWrite(uint64_t ullUsed)
+    {
+        m_slots[ProducerId()].ullWrite.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t ullHigh = m_ullHighWater.load(std::memory_order_relaxed);
+        while (ullUsed > ullHigh
+               && !m_ullHighWater.compare_exchange_weak(ullHigh, ullUsed, std::memory_order_relaxed)) {
+        }
+    }
+
+    void OnDrop()
+    {
+        m_slots[ProducerId()].ullDrop.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t GetWrite(int nProducer) const
+    {
+        return m_slots[nProducer % MAX_RING_PRODUCERS].ullWrite.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetDrop(int nProducer) const
+    {
+        return m_slots[nProducer % MAX_RING_PRODUCERS].ullDrop.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetTotalDrop() const
+    {
+        uint64_t ullTotal = 0;
+        for (int i = 0; i < MAX_RING_PRODUCERS; ++i) {
+            ullTotal += m_slots[i].ullDrop.load(std::memory_order_relaxed);
+        }
+        return ullTotal;
+    }
+
+    uint64_t GetHighWater() const
+    {
+        return m_ullHighWater.load(std::memory_order_relaxed);
+    }
+
+    // 返回并清零水位, 用于按周期上报
+    uint64_t ResetHighWater()
+    {
+        return m_ullHighWater.exchange(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        alignas(64) std::atomic<uint64_t> ullWrite;
+        std::atomic<uint64_t> ullDrop;
+    };
+
+    Slot m_slots[MAX_RING_PRODUCERS];
+    alignas(64) std::atomic<uint64_t> m_ullHighWater;
+};
+
+
+// 限频日志: 每个周期最多输出一次, 其余只计数, 下次输出时带上被抑制的条数
+class CRateLimitedLog
+{
+public:
+    explicit CRateLimitedLog(int nIntervalMs = DEFAULT_REPORT_INTERVAL_MS)
+        : m_nIntervalMs(nIntervalMs), m_llLastMs(-nIntervalMs), m_ullSuppressed(0)
+    {}
+
+    // 返回true时由调用者输出日志, ullSuppressed为上次输出后被抑制的条数
+    bool ShouldReport(uint64_t &ullSuppressed)
+    {
+        int64_t llNow = NowMs();
+        int64_t llLast = m_llLastMs.load(std::memory_order_relaxed);
+        if (llNow - llLast >= m_nIntervalMs
+            && m_llLastMs.compare_exchange_strong(llLast, llNow, std::memory_order_relaxed)) {
+            ullSuppressed = m_ullSuppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+
+        m_ullSuppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void SetInterval(int nIntervalMs)
+    {
+        m_nIntervalMs = nIntervalMs;
+    }
+
+private:
+    static int64_t NowMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    int m_nIntervalMs;
+    std::atomic<int64_t> m_llLastMs;
+    std::atomic<uint64_t> m_ullSuppressed;
+};
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef _SEQUENCE_RING_H_
+#define _SEQUENCE_RING_H_
+
+#include <stdint.h>
+#include <sched.h>
+#include <vector>
+#include <atomic>
+
+#include "WaitStrategy.h"
+
+#define CACHE_LINE_SIZE     64
+
+
+// 独占一个cache line的序号, 避免不同阶段之间的伪共享
+class CSequence
+{
+public:
+    explicit CSequence(int64_t llInit = -1) : m_llValue(llInit) {}
+
+    int64_t Get() const
+    {
+        return m_llValue.load(std::memory_order_acquire);
+    }
+
+    void Set(int64_t llValue)
+    {
+        m_llValue.store(llValue, std::memory_order_release);
+    }
+
+private:
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> m_llValue;
+    char m_pad[CACHE_LINE_SIZE - sizeof(std::atomic<int64_t>)];
+};
+
+inline int64_t MinSequence(const std::vector<CSequence *> &vecSeq, int64_t llDefault)
+{
+    int64_t llMin = llDefault;
+    for (size_t i = 0; i < vecSeq.size(); ++i) {
+        int64_t llValue = vecSeq[i]->Get();
+        if (llValue < llMin) {
+            llMin = llValue;
+        }
+    }
+    return llMin;
+}
+
+
+// 序号屏障: 等待生产者游标以及上游阶段都越过指定序号
+class CSequenceBarrier
+{
+public:
+    CSequenceBarrier(CSequence *pCursor, CWaitStrategy *pWait, const std::vector<CSequence *> &vecDepends)
+        : m_pCursor(pCursor), m_pWait(pWait), m_vecDepends(vecDepends), m_bAlert(false)
+    {}
+
+    // 等待llSeq可处理, 返回当前可处理的最大序号(可能大于llSeq, 用于批量处理)
+    // 超时或Alert时返回值小于llSeq
+    int64_t WaitFor(int64_t llSeq, int nTimeoutMs = -1)
+    {
+        int64_t llAvailable = Available();
+        if (llAvailable >= llSeq || NULL == m_pWait) {
+            return llAvailable;
+        }
+
+        WaitContext ctx;
+        ctx.pBarrier = this;
+        ctx.llSeq = llSeq;
+        m_pWait->Wait(IsReady, &ctx, nTimeoutMs);
+
+        return Available();
+    }
+
+    // 唤醒并终止等待, 阶段退出时使用
+    void Alert()
+    {
+        m_bAlert.store(true, std::memory_order_release);
+        if (NULL != m_pWait) {
+            m_pWait->NotifyAll();
+        }
+    }
+
+    bool IsAlerted() const
+    {
+        return m_bAlert.load(std::memory_order_acquire);
+    }
+
+private:
+    struct WaitContext {
+        CSequenceBarrier *pBarrier;
+        int64_t llSeq;
+    };
+
+    int64_t Available() const
+    {
+        int64_t llCursor = m_pCursor->Get();
+        return m_vecDepends.empty() ? llCursor : MinSequence(m_vecDepends, llCursor);
+    }
+
+    static bool IsReady(void *pContext)
+    {
+        WaitContext *pCtx = (WaitContext *)pContext;
+        return pCtx->pBarrier->IsAlerted() || pCtx->pBarrier->Available() >= pCtx->llSeq;
+    }
+
+private:
+    CSequence *m_pCursor;
+    CWaitStrategy *m_pWait;
+    std::vector<CSequence *> m_vecDepends;
+    std::atomic<bool> m_bAlert;
+};
+
+
+// Disruptor风格的单生产者环形缓冲区, 多个消费阶段共享同一块预分配的存储
+// 槽位对象原地复用, 阶段之间只传递序号, 不拷贝数据
+template<class T, int nSize>
+class CSequenceRing
+{
+    static_assert(nSize > 0 && (nSize & (nSize - 1)) == 0, "nSize must be a power of 2");
+
+public:
+    CSequenceRing() : m_pWait(NULL), m_llNext(0), m_llGatingCache(-1)
+    {
+        m_pBuf.resize(nSize);
+    }
+
+    virtual ~CSequenceRing()
+    {
+        for (size_t i = 0; i < m_vecBarrier.size(); ++i) {
+            delete m_vecBarrier[i];
+        }
+    }
+
+    // 必须在创建屏障之前设置, 建议使用WAIT_SPIN_FUTEX(多个阶段同时park时可全部唤醒)
+    void SetWaitStrategy(CWaitStrategy *pWait)
+    {
+        m_pWait = pWait;
+    }
+
+    // 最下游阶段的序号, 生产者不会覆盖其尚未处理的槽位
+    void AddGatingSequence(CSequence *pSeq)
+    {
+        m_vecGating.push_back(pSeq);
+    }
+
+    // 依赖vecDepends中的阶段(为空时直接依赖生产者), 返回的屏障由ring负责释放
+    CSequenceBarrier *NewBarrier(const std::vector<CSequence *> &vecDepends = std::vector<CSequence *>())
+    {
+        CSequenceBarrier *pBarrier = new CSequenceBarrier(&m_cursor, m_pWait, vecDepends);
+        m_vecBarrier.push_back(pBarrier);
+        return pBarrier;
+    }
+
+    // 申请nCount个槽位, 空间不足时等待下游阶段; 返回最后一个槽位的序号
+    int64_t Next(int nCount = 1)
+    {
+        int64_t llSeq = 0;
+        while (!TryNext(llSeq, nCount)) {
+            CPU_RELAX();
+            sched_yield();
+        }
+        return llSeq;
+    }
+
+    bool TryNext(int64_t &llSeq, int nCount = 1)
+    {
+        if (nCount <= 0 || nCount > nSize) {
+            return false;
+        }
+
+        int64_t llNext = m_llNext + nCount;
+        int64_t llWrap = llNext - 1 - nSize;
+
+        if (llWrap > m_llGatingCache) {
+            m_llGatingCache = MinSequence(m_vecGating, m_llNext - 1);
+            if (llWrap > m_llGatingCache) {
+                return false;
+            }
+        }
+
+        m_llNext = llNext;
+        llSeq = llNext - 1;
+        return true;
+    }
+
+    T& operator[] (int64_t llSeq)
+    {
+        return m_pBuf[llSeq & (nSize - 1)];
+    }
+
+    // 发布到llSeq为止的全部槽位
+    void Publish(int64_t llSeq)
+    {
+        m_cursor.Set(llSeq);
+        if (NULL != m_pWait) {
+            m_pWait->NotifyAll();
+        }
+    }
+
+    CSequence& Cursor()
+    {
+        return m_cursor;
+    }
+
+    CWaitStrategy *GetWaitStrategy()
+    {
+        return m_pWait;
+    }
+
+private:
+    CSequenceRing(const CSequenceRing &);
+    void operator=(const CSequenceRing &);
+
+    std::vector<T> m_pBuf;
+
+    CSequence m_cursor;                         // 已发布的最大序号
+    CWaitStrategy *m_pWait;
+    std::vector<CSequence *> m_vecGating;
+    std::vector<CSequenceBarrier *> m_vecBarrier;
+
+    int64_t m_llNext;                           // 生产者线程私有
+    int64_t m_llGatingCache;
+};
+
+
+// 一个消费阶段: 在屏障上等待, 按批处理槽位后推进自己的序号
+template<class T, int nSize>
+class CBatchEventProcessor
+{
+public:
+    typedef void (*EventHandler)(T &event, int64_t llSeq, bool bEndOfBatch, void *pContext);
+
+    CBatchEventProcessor(CSequenceRing<T, nSize> &ring, CSequenceBarrier *pBarrier, EventHandler pfnHandler, void *pContext = NULL)
+        : m_ring(ring), m_pBarrier(pBarrier), m_pfnHandler(pfnHandler), m_pContext(pContext)
+    {}
+
+    CSequence& GetSequence()
+    {
+        return m_sequence;
+    }
+
+    // 在阶段线程中调用, Halt()后返回
+    void Run()
+    {
+        int64_t llNext = m_sequence.Get() + 1;
+        while (!m_pBarrier->IsAlerted()) {
+            int64_t llAvailable = m_pBarrier->WaitFor(llNext, 100);
+            if (llAvailable < llNext) {
+                continue;
+            }
+
+            for (; llNext <= llAvailable; ++llNext) {
+                m_pfnHandler(m_ring[llNext], llNext, llNext == llAvailable, m_pContext);
+            }
+
+            m_sequence.Set(llAvailable);
+
+            // 唤醒等待本阶段的下游阶段和生产者
+            CWaitStrategy *pWait = m_ring.GetWaitStrategy();
+            if (NULL != pWait) {
+                pWait->NotifyAll();
+            }
+        }
+    }
+
+    void Halt()
+    {
+        m_pBarrier->Alert();
+    }
+
+    static void Entry(void *pContext)
+    {
+        ((CBatchEventProcessor *)pContext)->Run();
+    }
+
+private:
+    CSequenceRing<T, nSize> &m_ring;
+    CSequenceBarrier *m_pBarrier;
+    EventHandler m_pfnHandler;
+    void *m_pContext;
+
+    CSequence m_sequence;
+};
+
+#endif
@@ -0,0 +1,293 @@
+#ifndef _WAIT_STRATEGY_H_
+#define _WAIT_STRATEGY_H_
+
+#include <limits.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <atomic>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_RELAX()     _mm_pause()
+#elif defined(__aarch64__)
+#define CPU_RELAX()     __asm__ __volatile__("yield" ::: "memory")
+#else
+#define CPU_RELAX()     __asm__ __volatile__("" ::: "memory")
+#endif
+
+#define DEFAULT_SPIN_COUNT      200
+
+
+enum WAIT_STRATEGY_TYPE {
+    WAIT_BUSY_SPIN = 0,     // 一直自旋, 延迟最低, 独占一个核
+    WAIT_SPIN_YIELD = 1,    // 自旋一段时间后sched_yield
+    WAIT_SPIN_FUTEX = 2,    // 自旋一段时间后futex park, 空闲不占CPU
+    WAIT_EVENTFD = 3,       // eventfd, 可加入epoll与网络事件统一处理
+};
+
+// 判断数据是否就绪
+typedef bool (*WaitReadyFunc)(void *pContext);
+
+
+// 消费者等待策略; 生产者发布数据后调用Notify(), 只有消费者已park时才会产生系统调用
+class CWaitStrategy
+{
+public:
+    virtual ~CWaitStrategy() {}
+
+    // 等待pfnReady返回true, nTimeoutMs < 0 一直等待; 返回是否就绪
+    virtual bool Wait(WaitReadyFunc pfnReady, void *pContext, int nTimeoutMs) = 0;
+
+    virtual void Notify() {}
+
+    // 唤醒全部等待者, 退出时使用
+    virtual void NotifyAll() { Notify(); }
+
+    static CWaitStrategy *Create(int nType, int nSpin = DEFAULT_SPIN_COUNT);
+
+protected:
+    typedef std::chrono::steady_clock Clock;
+
+    static Clock::time_point Deadline(int nTimeoutMs)
+    {
+        if (nTimeoutMs < 0) {
+            return Clock::time_point::max();
+        }
+        return Clock::now() + std::chrono::milliseconds(nTimeoutMs);
+    }
+
+    // 距离deadline的剩余毫秒数, -1表示不超时
+    static int Remain(Clock::time_point tpDeadline)
+    {
+        if (tpDeadline == Clock::time_point::max()) {
+            return -1;
+        }
+
+        Clock::time_point tpNow = Clock::now();
+        if (tpNow >= tpDeadline) {
+            return 0;
+        }
+        return (int)std::chrono::duration_cast<std::chrono::milliseconds>(tpDeadline - tpNow).count() + 1;
+    }
+
+    // 自旋nSpin次, 期间就绪返回true
+    static bool Spin(WaitReadyFunc pfnReady, void *pContext, int nSpin)
+    {
+        for (int i = 0; i < nSpin; ++i) {
+            if (pfnReady(pContext)) {
+                return true;
+            }
+            CPU_RELAX();
+        }
+        return false;
+    }
+};
+
+
+class CBusySpinWait : public CWaitStrategy
+{
+public:
+    virtual bool Wait(WaitReadyFunc pfnReady, void *pContext, int nTimeoutMs)
+    {
+        Clock::time_point tpDeadline = Deadline(nTimeoutMs);
+        while (!Spin(pfnReady, pContext, 1024)) {
+            if (0 == Remain(tpDeadline)) {
+                return pfnReady(pContext);
+            }
+        }
+        return true;
+    }
+};
+
+
+class CSpinYieldWait : public CWaitStrategy
+{
+public:
+    explicit CSpinYieldWait(int nSpin = DEFAULT_SPIN_COUNT) : m_nSpin(nSpin) {}
+
+    virtual bool Wait(WaitReadyFunc pfnReady, void *pContext, int nTimeoutMs)
+    {
+        if (Spin(pfnReady, pContext, m_nSpin)) {
+            return true;
+        }
+
+        Clock::time_point tpDeadline = Deadline(nTimeoutMs);
+        while (!pfnReady(pContext)) {
+            if (0 == Remain(tpDeadline)) {
+                return false;
+            }
+            sched_yield();
+        }
+        return true;
+    }
+
+private:
+    int m_nSpin;
+};
+
+
+class CSpinFutexWait : public CWaitStrategy
+{
+public:
+    explicit CSpinFutexWait(int nSpin = DEFAULT_SPIN_COUNT) : m_nSpin(nSpin), m_uSeq(0), m_uWaiters(0) {}
+
+    virtual bool Wait(WaitReadyFunc pfnReady, void *pContext, int nTimeoutMs)
+    {
+        if (Spin(pfnReady, pContext, m_nSpin)) {
+            return true;
+        }
+
+        Clock::time_point tpDeadline = Deadline(nTimeoutMs);
+        while (true) {
+            uint32_t uSeq = m_uSeq.load(std::memory_order_seq_cst);
+            m_uWaiters.fetch_add(1, std::memory_order_seq_cst);
+
+            // 登记后再检查一次, 防止与Notify交错丢失唤醒
+            bool bReady = pfnReady(pContext);
+            int nRemain = Remain(tpDeadline);
+            if (!bReady && 0 != nRemain) {
+                struct timespec ts;
+                ts.tv_sec = nRemain / 1000;
+                ts.tv_nsec = (nRemain % 1000) * 1000000;
+                syscall(SYS_futex, (uint32_t *)&m_uSeq, FUTEX_WAIT_PRIVATE, uSeq, nRemain < 0 ? NULL : &ts, NULL, 0);
+            }
+
+            m_uWaiters.fetch_sub(1, std::memory_order_seq_cst);
+
+            if (bReady || pfnReady(pContext)) {
+                return true;
+            }
+            if (0 == Remain(tpDeadline)) {
+                return false;
+            }
+        }
+    }
+
+    virtual void Notify()
+    {
+        m_uSeq.fetch_add(1, std::memory_order_seq_cst);
+        if (m_uWaiters.load(std::memory_order_seq_cst) > 0) {
+            syscall(SYS_futex, (uint32_t *)&m_uSeq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+        }
+    }
+
+    virtual void NotifyAll()
+    {
+        m_uSeq.fetch_add(1, std::memory_order_seq_cst);
+        if (m_uWaiters.load(std::memory_order_seq_cst) > 0) {
+            syscall(SYS_futex, (uint32_t *)&m_uSeq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+        }
+    }
+
+private:
+    int m_nSpin;
+    std::atomic<uint32_t> m_uSeq;
+    std::atomic<uint32_t> m_uWaiters;
+};
+
+
+// eventfd等待; 在自己的epoll循环中使用时:
+// Arm() -> 再次检查数据 -> epoll_wait(GetFd()) -> Disarm()
+class CEventFdWait : public CWaitStrategy
+{
+public:
+    explicit CEventFdWait(int nSpin = DEFAULT_SPIN_COUNT) : m_nSpin(nSpin), m_uWaiters(0)
+    {
+        m_nFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+
+    virtual ~CEventFdWait()
+    {
+        if (m_nFd >= 0) {
+            close(m_nFd);
+        }
+    }
+
+    int GetFd() const { return m_nFd; }
+
+    void Arm()
+    {
+        m_uWaiters.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    void Disarm()
+    {
+        uint64_t ullCount = 0;
+        ssize_t nRet = read(m_nFd, &ullCount, sizeof(ullCount));
+        (void)nRet;
+        m_uWaiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    virtual bool Wait(WaitReadyFunc pfnReady, void *pContext, int nTimeoutMs)
+    {
+        if (Spin(pfnReady, pContext, m_nSpin)) {
+            return true;
+        }
+
+        Clock::time_point tpDeadline = Deadline(nTimeoutMs);
+        while (true) {
+            Arm();
+
+            bool bReady = pfnReady(pContext);
+            int nRemain = Remain(tpDeadline);
+            if (!bReady && 0 != nRemain) {
+                struct pollfd pfd;
+                pfd.fd = m_nFd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                poll(&pfd, 1, nRemain);
+            }
+
+            Disarm();
+
+            if (bReady || pfnReady(pContext)) {
+                return true;
+            }
+            if (0 == Remain(tpDeadline)) {
+                return false;
+            }
+        }
+    }
+
+    virtual void Notify()
+    {
+        // 与消费者Arm()后的检查配对, 防止发布数据的store与waiters的load重排
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_uWaiters.load(std::memory_order_seq_cst) > 0) {
+            uint64_t ullOne = 1;
+            ssize_t nRet = write(m_nFd, &ullOne, sizeof(ullOne));
+            (void)nRet;
+        }
+    }
+
+private:
+    int m_nSpin;
+    int m_nFd;
+    std::atomic<uint32_t> m_uWaiters;
+};
+
+
+inline CWaitStrategy *CWaitStrategy::Create(int nType, int nSpin)
+{
+    switch (nType) {
+    case WAIT_BUSY_SPIN:
+        return new CBusySpinWait();
+    case WAIT_SPIN_YIELD:
+        return new CSpinYieldWait(nSpin);
+    case WAIT_SPIN_FUTEX:
+        return new CSpinFutexWait(nSpin);
+    case WAIT_EVENTFD:
+        return new CEventFdWait(nSpin);
+    default:
+        return NULL;
+    }
+}
+
+#endif
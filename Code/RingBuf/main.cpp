@@ -1,9 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <thread>
+#include <chrono>
 
 #include "RingBuffer.h"
 #include "RingBuf.h"
+#include "SequenceRing.h"
 
 
 struct TestNode
@@ -16,18 +20,145 @@ struct TestNode
     }
 };
 
+// 等待策略压测: 生产者分批写入, 批之间暂停让消费者进入park, 检查没有丢失唤醒
+#define WAIT_DEMO_COUNT     100000
+#define WAIT_DEMO_BATCH     500
+
+static void WaitStrategyDemo(int nType, const char *szName)
+{
+    CRingBuffer<int, 1024> ring;
+    CWaitStrategy *pWait = CWaitStrategy::Create(nType);
+    ring.SetWaitStrategy(pWait);
+
+    int nRecv = 0;
+    int nTimeout = 0;
+    std::thread consumer([&]() {
+        int nValue = 0;
+        while (nRecv < WAIT_DEMO_COUNT) {
+            if (ring.WaitPop(nValue, 1000)) {
+                ++nRecv;
+            } else {
+                ++nTimeout;     // 有数据却等待超时说明丢失了唤醒
+            }
+        }
+    });
+
+    std::chrono::steady_clock::time_point tpStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < WAIT_DEMO_COUNT; ++i) {
+        while (!ring.Push(i)) {
+            sched_yield();
+        }
+        if (0 == (i + 1) % WAIT_DEMO_BATCH) {
+            usleep(200);
+        }
+    }
+    consumer.join();
+
+    double dMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tpStart).count();
+    printf("wait strategy %-10s recv:%d timeout:%d cost:%.1fms\n", szName, nRecv, nTimeout, dMs);
+
+    delete pWait;
+}
+
+// 序号环流水线: 生产者 -> stage1(计算) -> stage2(校验), stage2是最下游的gating阶段
+#define PIPELINE_COUNT      200000
+
+struct PipelineEvent
+{
+    int64_t llValue;
+    int64_t llDouble;   // stage1写入, stage2读取
+};
+
+struct PipelineResult
+{
+    int64_t llSum;
+    int64_t llError;
+    int64_t llBatch;
+};
+
+static void Stage1Handler(PipelineEvent &event, int64_t, bool, void *)
+{
+    event.llDouble = event.llValue * 2;
+}
+
+static void Stage2Handler(PipelineEvent &event, int64_t, bool bEndOfBatch, void *pContext)
+{
+    PipelineResult *pResult = (PipelineResult *)pContext;
+    if (event.llDouble != event.llValue * 2) {
+        ++pResult->llError;     // stage2越过了stage1
+    }
+    pResult->llSum += event.llValue;
+    if (bEndOfBatch) {
+        ++pResult->llBatch;
+    }
+}
+
+static void SequencePipelineDemo()
+{
+    typedef CSequenceRing<PipelineEvent, 1024> PipelineRing;
+    typedef CBatchEventProcessor<PipelineEvent, 1024> PipelineStage;
+
+    CWaitStrategy *pWait = CWaitStrategy::Create(WAIT_SPIN_FUTEX);
+    PipelineRing ring;
+    ring.SetWaitStrategy(pWait);
+
+    PipelineResult result = {0, 0, 0};
+    PipelineStage stage1(ring, ring.NewBarrier(), Stage1Handler);
+    std::vector<CSequence *> vecDepends(1, &stage1.GetSequence());
+    PipelineStage stage2(ring, ring.NewBarrier(vecDepends), Stage2Handler, &result);
+    ring.AddGatingSequence(&stage2.GetSequence());
+
+    std::thread thd1(PipelineStage::Entry, &stage1);
+    std::thread thd2(PipelineStage::Entry, &stage2);
+
+    for (int64_t i = 0; i < PIPELINE_COUNT; ++i) {
+        int64_t llSeq = ring.Next();
+        ring[llSeq].llValue = i;
+        ring.Publish(llSeq);
+    }
+
+    // 等最下游处理完再停止
+    while (stage2.GetSequence().Get() < PIPELINE_COUNT - 1) {
+        usleep(1000);
+    }
+    stage1.Halt();
+    stage2.Halt();
+    thd1.join();
+    thd2.join();
+
+    int64_t llExpect = (int64_t)PIPELINE_COUNT * (PIPELINE_COUNT - 1) / 2;
+    printf("sequence pipeline sum:%s error:%ld batches:%ld\n", result.llSum == llExpect ? "ok" : "mismatch",
+           (long)result.llError, (long)result.llBatch);
+
+    delete pWait;
+}
+
 int main()
 {
+    SequencePipelineDemo();
+
+    WaitStrategyDemo(WAIT_SPIN_YIELD, "spin_yield");
+    WaitStrategyDemo(WAIT_SPIN_FUTEX, "spin_futex");
+    WaitStrategyDemo(WAIT_EVENTFD, "eventfd");
+    WaitStrategyDemo(WAIT_BUSY_SPIN, "busy_spin");
+
     CRingBuf							ringData;
     CRingBuffer<TestNode, 300>		    nodeRing;
 
-    ringData.Init(102400);
+    // 锁定内存并用2个线程预缺页, mlock受RLIMIT_MEMLOCK限制失败时退化为预缺页
+    ringData.Init(102400, RING_ALLOC_THP | RING_ALLOC_MLOCK | RING_ALLOC_PREFAULT, 2);
     nodeRing.SetBufferName("Test Node Ring");
 
 
     char bufName[1024];
-    while(gets(bufName) != NULL && 0 != strcmp(bufName, "quit"))
+    while(fgets(bufName, sizeof(bufName), stdin) != NULL)
     {
+        bufName[strcspn(bufName, "\n")] = '\0';
+        if (0 == strcmp(bufName, "quit"))
+        {
+            break;
+        }
+
         printf("input: %s\n", bufName);
 
         TestNode node;
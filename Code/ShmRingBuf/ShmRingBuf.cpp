@@ -0,0 +1,561 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "ShmRingBuf.h"
+
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "shm ring needs lock-free atomics");
+
+static int futex_wait(std::atomic<uint32_t> *pAddr, uint32_t uVal, int nTimeoutMs)
+{
+    struct timespec ts;
+    struct timespec *pts = NULL;
+    if (nTimeoutMs >= 0) {
+        ts.tv_sec = nTimeoutMs / 1000;
+        ts.tv_nsec = (nTimeoutMs % 1000) * 1000000;
+        pts = &ts;
+    }
+
+    // 非FUTEX_PRIVATE_FLAG, 跨进程共享
+    return syscall(SYS_futex, (uint32_t *)pAddr, FUTEX_WAIT, uVal, pts, NULL, 0);
+}
+
+static int futex_wake(std::atomic<uint32_t> *pAddr, int nCount)
+{
+    return syscall(SYS_futex, (uint32_t *)pAddr, FUTEX_WAKE, nCount, NULL, NULL, 0);
+}
+
+static bool process_alive(int32_t nPid)
+{
+    if (nPid <= 0) {
+        return false;
+    }
+
+    return !(kill(nPid, 0) == -1 && errno == ESRCH);
+}
+
+
+CShmRingBuf::CShmRingBuf()
+{
+    m_pHeader = NULL;
+    m_pData = NULL;
+    m_nSize = 0;
+    m_nMapSize = 0;
+    m_nShmFd = -1;
+    m_nEventFd = -1;
+    m_nNotify = SHM_NOTIFY_FUTEX;
+    m_bConsumer = false;
+    m_ullReadPos = 0;
+}
+
+CShmRingBuf::~CShmRingBuf()
+{
+    Detach();
+}
+
+bool CShmRingBuf::Create(const char *szName, unsigned int nSize)
+{
+    if (NULL != m_pHeader || NULL == szName) {
+        return false;
+    }
+
+    int nFd = shm_open(szName, O_CREAT | O_RDWR, 0666);
+    if (nFd < 0) {
+        printf("CShmRingBuf::Create shm_open %s failed: %s\n", szName, strerror(errno));
+        return false;
+    }
+
+    return Map(nFd, true, nSize, false);
+}
+
+bool CShmRingBuf::CreateMemfd(const char *szName, unsigned int nSize)
+{
+    if (NULL != m_pHeader) {
+        return false;
+    }
+
+    int nFd = syscall(SYS_memfd_create, szName ? szName : "shm_ring", 0);
+    if (nFd < 0) {
+        printf("CShmRingBuf::CreateMemfd failed: %s\n", strerror(errno));
+        return false;
+    }
+
+    return Map(nFd, true, nSize, false);
+}
+
+bool CShmRingBuf::Attach(const char *szName, bool bConsumer)
+{
+    if (NULL != m_pHeader || NULL == szName) {
+        return false;
+    }
+
+    int nFd = shm_open(szName, O_RDWR, 0666);
+    if (nFd < 0) {
+        printf("CShmRingBuf::Attach shm_open %s failed: %s\n", szName, strerror(errno));
+        return false;
+    }
+
+    return Map(nFd, false, 0, bConsumer);
+}
+
+bool CShmRingBuf::AttachFd(int nFd, bool bConsumer)
+{
+    if (NULL != m_pHeader || nFd < 0) {
+        return false;
+    }
+
+    int nDupFd = dup(nFd);
+    if (nDupFd < 0) {
+        return false;
+    }
+
+    return Map(nDupFd, false, 0, bConsumer);
+}
+
+bool CShmRingBuf::Map(int nFd, bool bCreate, unsigned int nSize, bool bConsumer)
+{
+    struct stat st;
+    if (fstat(nFd, &st) != 0) {
+        close(nFd);
+        return false;
+    }
+
+    size_t nHeadSize = (sizeof(ShmRingHeader) + SHM_RING_ALIGN - 1) & ~(SHM_RING_ALIGN - 1);
+    size_t nMapSize = (size_t)st.st_size;
+
+    if (bCreate) {
+        nSize &= ~(SHM_RING_ALIGN - 1);
+        if (nSize < SHM_RING_ALIGN * 4) {
+            printf("CShmRingBuf::Map size(%u) too small\n", nSize);
+            close(nFd);
+            return false;
+        }
+
+        if (nMapSize != nHeadSize + nSize) {
+            nMapSize = nHeadSize + nSize;
+            if (ftruncate(nFd, nMapSize) != 0) {
+                printf("CShmRingBuf::Map ftruncate failed: %s\n", strerror(errno));
+                close(nFd);
+                return false;
+            }
+        }
+    } else if (nMapSize <= nHeadSize) {
+        printf("CShmRingBuf::Map shm not initialized\n");
+        close(nFd);
+        return false;
+    }
+
+    void *pAddr = mmap(NULL, nMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, nFd, 0);
+    if (MAP_FAILED == pAddr) {
+        printf("CShmRingBuf::Map mmap failed: %s\n", strerror(errno));
+        close(nFd);
+        return false;
+    }
+
+    ShmRingHeader *pHeader = (ShmRingHeader *)pAddr;
+    bool bValid = (SHM_RING_MAGIC == pHeader->uMagic
+                   && SHM_RING_VERSION == pHeader->uVersion
+                   && sizeof(ShmRingHeader) == pHeader->uHeadSize
+                   && nHeadSize + pHeader->uDataSize == nMapSize);
+
+    if (bCreate && !bValid) {
+        // 新建或布局不兼容, 重新初始化; 兼容时保留未消费的数据(生产者重启)
+        memset(pAddr, 0, nMapSize);
+        pHeader = new (pAddr) ShmRingHeader();
+        pHeader->uVersion = SHM_RING_VERSION;
+        pHeader->uHeadSize = sizeof(ShmRingHeader);
+        pHeader->uDataSize = nSize;
+        pHeader->ullReserve.store(0);
+        pHeader->ullCommit.store(0);
+        pHeader->uSeq.store(0);
+        pHeader->uWaiters.store(0);
+        pHeader->nConsumerPid.store(0);
+        pHeader->uDropCount.store(0);
+        pHeader->uAbandonedCount.store(0);
+        for (int i = 0; i < SHM_RING_SLOTS; ++i) {
+            pHeader->arSlot[i].nPid.store(0);
+            pHeader->arSlot[i].ullPos.store(0);
+            pHeader->arSlot[i].ullSize.store(0);
+        }
+        __atomic_store_n(&pHeader->uMagic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+    } else if (!bValid) {
+        printf("CShmRingBuf::Map header mismatch <magic:0x%08x, version:%u>\n", pHeader->uMagic, pHeader->uVersion);
+        munmap(pAddr, nMapSize);
+        close(nFd);
+        return false;
+    }
+
+    if (bConsumer) {
+        // 单消费者: 上一个消费者仍存活时拒绝挂载
+        int32_t nOldPid = pHeader->nConsumerPid.load();
+        if (nOldPid != getpid() && (process_alive(nOldPid) || !pHeader->nConsumerPid.compare_exchange_strong(nOldPid, getpid()))) {
+            printf("CShmRingBuf::Map consumer(%d) still alive\n", pHeader->nConsumerPid.load());
+            munmap(pAddr, nMapSize);
+            close(nFd);
+            return false;
+        }
+        // 上一个消费者在Wait中崩溃时没有减去等待计数, 单消费者直接清零
+        pHeader->uWaiters.store(0);
+    }
+
+    m_pHeader = pHeader;
+    m_pData = (char *)pAddr + nHeadSize;
+    m_nSize = pHeader->uDataSize;
+    m_nMapSize = nMapSize;
+    m_nShmFd = nFd;
+    m_bConsumer = bConsumer;
+    m_ullReadPos = pHeader->ullCommit.load(std::memory_order_acquire);
+
+    return true;
+}
+
+void CShmRingBuf::Detach()
+{
+    if (NULL != m_pHeader) {
+        if (m_bConsumer) {
+            int32_t nPid = getpid();
+            m_pHeader->nConsumerPid.compare_exchange_strong(nPid, 0);
+        }
+        munmap(m_pHeader, m_nMapSize);
+    }
+
+    if (m_nShmFd >= 0) {
+        close(m_nShmFd);
+    }
+
+    m_pHeader = NULL;
+    m_pData = NULL;
+    m_nSize = 0;
+    m_nMapSize = 0;
+    m_nShmFd = -1;
+    m_ullReadPos = 0;
+}
+
+bool CShmRingBuf::Unlink(const char *szName)
+{
+    return 0 == shm_unlink(szName);
+}
+
+void CShmRingBuf::SetNotify(int nNotify, int nEventFd)
+{
+    m_nNotify = nNotify;
+    m_nEventFd = nEventFd;
+}
+
+bool CShmRingBuf::Write(const char *pData, unsigned int nLen)
+{
+    if (NULL == m_pHeader || NULL == pData || 0 == nLen) {
+        return false;
+    }
+
+    uint64_t ullNeed = RecordSize(nLen);
+    if (ullNeed > m_nSize) {
+        m_pHeader->uDropCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    ShmRingSlot *pSlot = ClaimSlot();
+    uint64_t ullPos = m_pHeader->ullReserve.load(std::memory_order_relaxed);
+    uint64_t ullPad = 0;
+    do {
+        uint64_t ullOff = ullPos % m_nSize;
+        ullPad = (ullOff + ullNeed > m_nSize) ? m_nSize - ullOff : 0;
+
+        uint64_t ullCommit = m_pHeader->ullCommit.load(std::memory_order_acquire);
+        if (ullPos + ullPad + ullNeed - ullCommit > m_nSize) {
+            m_pHeader->uDropCount.fetch_add(1, std::memory_order_relaxed);
+            ReleaseSlot(pSlot);
+            return false;
+        }
+
+        // 先登记再预留, 预留成功后登记立即生效; CAS失败留下的过期登记由SkipAbandoned甄别
+        if (NULL != pSlot) {
+            pSlot->ullPos.store(ullPos);
+            pSlot->ullSize.store(ullPad + ullNeed);
+        }
+    } while (!m_pHeader->ullReserve.compare_exchange_weak(ullPos, ullPos + ullPad + ullNeed,
+                                                          std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    if (ullPad > 0) {
+        ShmRingRecord *pPad = RecordAt(ullPos);
+        pPad->uLen = (uint32_t)ullPad;
+        pPad->nPid = getpid();
+        pPad->uState.store(SHM_RECORD_PAD, std::memory_order_release);
+        ullPos += ullPad;
+    }
+
+    ShmRingRecord *pRecord = RecordAt(ullPos);
+    pRecord->uLen = nLen;
+    pRecord->nPid = getpid();
+    pRecord->uState.store(SHM_RECORD_WRITING, std::memory_order_release);
+    ReleaseSlot(pSlot);     // 之后崩溃由WRITING状态处理
+    memcpy((char *)(pRecord + 1), pData, nLen);
+    pRecord->uState.store(SHM_RECORD_READY, std::memory_order_release);
+
+    Notify();
+
+    return true;
+}
+
+ShmRingSlot *CShmRingBuf::ClaimSlot()
+{
+    static thread_local unsigned int s_uHint = 0;
+
+    int32_t nPid = getpid();
+    for (unsigned int i = 0; i < SHM_RING_SLOTS; ++i) {
+        unsigned int uIndex = (s_uHint + i) % SHM_RING_SLOTS;
+        ShmRingSlot *pSlot = &m_pHeader->arSlot[uIndex];
+
+        int32_t nOwner = pSlot->nPid.load(std::memory_order_relaxed);
+        if (0 != nOwner) {
+            // 崩溃的生产者留下的登记, 消费者已越过该预留后才能回收
+            uint64_t ullSize = pSlot->ullSize.load();
+            if (nOwner == nPid || process_alive(nOwner)
+                || (0 != ullSize && pSlot->ullPos.load() + ullSize > m_pHeader->ullCommit.load(std::memory_order_acquire))) {
+                continue;
+            }
+        }
+
+        if (pSlot->nPid.compare_exchange_strong(nOwner, nPid)) {
+            pSlot->ullSize.store(0);
+            s_uHint = uIndex;
+            return pSlot;
+        }
+    }
+
+    return NULL;
+}
+
+void CShmRingBuf::ReleaseSlot(ShmRingSlot *pSlot)
+{
+    if (NULL != pSlot) {
+        pSlot->ullSize.store(0);
+        pSlot->nPid.store(0, std::memory_order_release);
+    }
+}
+
+// 读位置上的记录为FREE时, 检查是否属于已崩溃生产者的预留; 是则改为PAD记录, 由Read/Commit正常跳过
+// 登记在预留CAS之前写入, CAS失败后崩溃的生产者会留下指向别人预留的过期登记, 因此:
+// 读位置总是记录边界, 只认起点等于读位置的登记; 有存活的生产者登记了该位置时等待它写入;
+// 多个已崩溃的登记长度不一致时无法确定真正的预留, 不跳过
+bool CShmRingBuf::SkipAbandoned()
+{
+    int32_t nDead = 0;
+    uint64_t ullDeadSize = 0;
+    for (int i = 0; i < SHM_RING_SLOTS; ++i) {
+        ShmRingSlot *pSlot = &m_pHeader->arSlot[i];
+        int32_t nOwner = pSlot->nPid.load(std::memory_order_acquire);
+        uint64_t ullSize = pSlot->ullSize.load();
+        if (0 == nOwner || 0 == ullSize || pSlot->ullPos.load() != m_ullReadPos) {
+            continue;
+        }
+        if (process_alive(nOwner)) {
+            return false;
+        }
+        if (0 != nDead && ullSize != ullDeadSize) {
+            printf("CShmRingBuf::Read ambiguous abandoned reserve at %lu\n", (unsigned long)m_ullReadPos);
+            return false;
+        }
+        nDead = nOwner;
+        ullDeadSize = ullSize;
+    }
+
+    // 真正的所有者可能已写入头部并释放了登记
+    ShmRingRecord *pRecord = RecordAt(m_ullReadPos);
+    if (0 == nDead || SHM_RECORD_FREE != pRecord->uState.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    pRecord->uLen = (uint32_t)ullDeadSize;
+    pRecord->nPid = nDead;
+    pRecord->uState.store(SHM_RECORD_PAD, std::memory_order_release);
+
+    m_pHeader->uAbandonedCount.fetch_add(1, std::memory_order_relaxed);
+    printf("CShmRingBuf::Read producer(%d) crashed after reserve, skip %u bytes\n", nDead, pRecord->uLen);
+    return true;
+}
+
+void CShmRingBuf::Notify()
+{
+    if (SHM_NOTIFY_NONE == m_nNotify) {
+        return;
+    }
+
+    m_pHeader->uSeq.fetch_add(1, std::memory_order_seq_cst);
+
+    // 只有消费者已park时才进行系统调用
+    if (0 == m_pHeader->uWaiters.load(std::memory_order_seq_cst)) {
+        return;
+    }
+
+    if (SHM_NOTIFY_EVENTFD == m_nNotify && m_nEventFd >= 0) {
+        uint64_t ullOne = 1;
+        ssize_t nRet = write(m_nEventFd, &ullOne, sizeof(ullOne));
+        (void)nRet;
+    } else {
+        futex_wake(&m_pHeader->uSeq, 1);
+    }
+}
+
+char *CShmRingBuf::Read(unsigned int &nLen)
+{
+    if (NULL == m_pHeader) {
+        return NULL;
+    }
+
+    while (m_ullReadPos != m_pHeader->ullReserve.load(std::memory_order_acquire)) {
+        ShmRingRecord *pRecord = RecordAt(m_ullReadPos);
+        uint32_t uState = pRecord->uState.load(std::memory_order_acquire);
+
+        if (SHM_RECORD_PAD == uState) {
+            m_ullReadPos += pRecord->uLen;
+            continue;
+        }
+
+        if (SHM_RECORD_READY == uState) {
+            nLen = pRecord->uLen;
+            m_ullReadPos += RecordSize(pRecord->uLen);
+            return (char *)(pRecord + 1);
+        }
+
+        if (SHM_RECORD_ABANDONED == uState) {
+            m_ullReadPos += RecordSize(pRecord->uLen);
+            continue;
+        }
+
+        // 预留后尚未写入头部时由预留登记得知长度
+        if (SHM_RECORD_FREE == uState && SkipAbandoned()) {
+            continue;
+        }
+
+        // 生产者写入过程中崩溃, 跳过该记录
+        if (SHM_RECORD_WRITING == uState && !process_alive(pRecord->nPid)) {
+            uint32_t uExpect = SHM_RECORD_WRITING;
+            if (pRecord->uState.compare_exchange_strong(uExpect, SHM_RECORD_ABANDONED)) {
+                m_pHeader->uAbandonedCount.fetch_add(1, std::memory_order_relaxed);
+                printf("CShmRingBuf::Read producer(%d) crashed, skip %u bytes\n", pRecord->nPid, pRecord->uLen);
+            }
+            continue;
+        }
+
+        break;
+    }
+
+    return NULL;
+}
+
+void CShmRingBuf::Commit()
+{
+    if (NULL == m_pHeader) {
+        return;
+    }
+
+    // 整段清零而不只是旧记录头: 下一圈记录边界会变, 预留后尚未写头部时读位置上必须是FREE,
+    // 不能是上一圈的数据被当成READY/PAD
+    uint64_t ullPos = m_pHeader->ullCommit.load(std::memory_order_relaxed);
+    if (ullPos < m_ullReadPos) {
+        uint64_t ullOff = ullPos % m_nSize;
+        uint64_t ullLen = m_ullReadPos - ullPos;
+        uint64_t ullFirst = (ullOff + ullLen > m_nSize) ? m_nSize - ullOff : ullLen;
+        memset(m_pData + ullOff, 0, ullFirst);
+        memset(m_pData, 0, ullLen - ullFirst);
+    }
+
+    m_pHeader->ullCommit.store(m_ullReadPos, std::memory_order_release);
+}
+
+bool CShmRingBuf::IsEmpty()
+{
+    if (NULL == m_pHeader) {
+        return true;
+    }
+
+    if (m_ullReadPos == m_pHeader->ullReserve.load(std::memory_order_acquire)) {
+        return true;
+    }
+
+    // 已预留但生产者尚未写完, 仍视为空
+    uint32_t uState = RecordAt(m_ullReadPos)->uState.load(std::memory_order_acquire);
+    return SHM_RECORD_FREE == uState || SHM_RECORD_WRITING == uState;
+}
+
+bool CShmRingBuf::Wait(int nTimeoutMs)
+{
+    if (NULL == m_pHeader) {
+        return false;
+    }
+
+    if (!IsEmpty()) {
+        return true;
+    }
+
+    if (SHM_NOTIFY_NONE == m_nNotify) {
+        return false;
+    }
+
+    uint32_t uSeq = m_pHeader->uSeq.load(std::memory_order_seq_cst);
+    m_pHeader->uWaiters.fetch_add(1, std::memory_order_seq_cst);
+
+    // 登记等待后再检查一次, 防止丢失唤醒
+    if (IsEmpty()) {
+        if (SHM_NOTIFY_EVENTFD == m_nNotify && m_nEventFd >= 0) {
+            struct pollfd pfd;
+            pfd.fd = m_nEventFd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, nTimeoutMs) > 0) {
+                uint64_t ullCount = 0;
+                ssize_t nRet = read(m_nEventFd, &ullCount, sizeof(ullCount));
+                (void)nRet;
+            }
+        } else {
+            futex_wait(&m_pHeader->uSeq, uSeq, nTimeoutMs);
+        }
+    }
+
+    m_pHeader->uWaiters.fetch_sub(1, std::memory_order_seq_cst);
+
+    return !IsEmpty();
+}
+
+bool CShmRingBuf::IsConsumerAlive()
+{
+    if (NULL == m_pHeader) {
+        return false;
+    }
+
+    return process_alive(m_pHeader->nConsumerPid.load(std::memory_order_relaxed));
+}
+
+float CShmRingBuf::GetUsed(unsigned int &uDrop)
+{
+    if (NULL == m_pHeader || 0 == m_nSize) {
+        uDrop = 0;
+        return 0.0;
+    }
+
+    uDrop = m_pHeader->uDropCount.load(std::memory_order_relaxed);
+
+    uint64_t ullUsed = m_pHeader->ullReserve.load(std::memory_order_relaxed) - m_pHeader->ullCommit.load(std::memory_order_relaxed);
+    return (float)ullUsed / (float)m_nSize;
+}
+
+unsigned int CShmRingBuf::GetAbandoned()
+{
+    if (NULL == m_pHeader) {
+        return 0;
+    }
+
+    return m_pHeader->uAbandonedCount.load(std::memory_order_relaxed);
+}
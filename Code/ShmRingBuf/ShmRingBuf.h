@@ -0,0 +1,156 @@
+#ifndef _SHM_RING_BUF_H_
+#define _SHM_RING_BUF_H_
+
+#include <stdint.h>
+#include <atomic>
+
+
+#define SHM_RING_MAGIC          0x53524E47      // "SRNG"
+#define SHM_RING_VERSION        2
+#define SHM_RING_ALIGN          16
+#define MAX_SHM_RING_SIZE       1024 * 1024 * 64
+#define SHM_RING_SLOTS          64              // 同时写入的生产者线程数上限, 超出时不登记预留
+
+
+// 记录状态
+enum SHM_RECORD_STATE {
+    SHM_RECORD_FREE = 0,
+    SHM_RECORD_WRITING = 1,     // 生产者已预留, 正在拷贝数据
+    SHM_RECORD_READY = 2,       // 数据可读
+    SHM_RECORD_PAD = 3,         // 尾部填充, 数据区回绕
+    SHM_RECORD_ABANDONED = 4,   // 生产者写入过程中崩溃, 消费者跳过
+};
+
+// 唤醒方式
+enum SHM_RING_NOTIFY {
+    SHM_NOTIFY_NONE = 0,        // 消费者自行轮询
+    SHM_NOTIFY_FUTEX = 1,       // 共享futex, 跨进程无需额外fd
+    SHM_NOTIFY_EVENTFD = 2,     // eventfd, 可加入消费者的epoll
+};
+
+
+// 每条记录前的头部, 16字节对齐
+struct ShmRingRecord
+{
+    std::atomic<uint32_t>   uState;
+    uint32_t                uLen;       // 数据长度; PAD记录为整个填充长度
+    int32_t                 nPid;       // 写入该记录的生产者进程
+    uint32_t                uReserved;
+};
+
+// 生产者的预留登记: 预留成功到写入记录头之间崩溃时, 消费者据此得知预留的位置和长度并跳过
+struct alignas(64) ShmRingSlot
+{
+    std::atomic<int32_t>    nPid;
+    uint32_t                uReserved;
+    std::atomic<uint64_t>   ullPos;
+    std::atomic<uint64_t>   ullSize;    // 0表示没有未写入记录头的预留
+};
+
+// 共享内存头部, 位于映射区起始位置; 布局变化时需要修改SHM_RING_VERSION
+struct ShmRingHeader
+{
+    uint32_t                uMagic;
+    uint32_t                uVersion;
+    uint32_t                uHeadSize;
+    uint32_t                uDataSize;
+
+    alignas(64) std::atomic<uint64_t>   ullReserve;     // 生产者预留位置, 单调递增
+    alignas(64) std::atomic<uint64_t>   ullCommit;      // 消费者已提交的读位置, 单调递增
+
+    alignas(64) std::atomic<uint32_t>   uSeq;           // futex字, 每次发布+1
+    std::atomic<uint32_t>   uWaiters;                   // 正在等待的消费者数量
+    std::atomic<int32_t>    nConsumerPid;
+    std::atomic<uint32_t>   uDropCount;
+    std::atomic<uint32_t>   uAbandonedCount;
+
+    ShmRingSlot             arSlot[SHM_RING_SLOTS];
+};
+
+
+// 进程间环形缓冲区: 多生产者(lock-free预留) / 单消费者
+// 消费者Read()得到的指针在Commit()前一直有效, 未提交的记录在消费者重启后会被重新读取
+class CShmRingBuf
+{
+public:
+    CShmRingBuf();
+    ~CShmRingBuf();
+
+public:
+    // 创建具名共享内存(shm_open); 已存在且版本/大小一致时直接复用
+    bool Create(const char *szName, unsigned int nSize = MAX_SHM_RING_SIZE);
+
+    // 创建匿名共享内存(memfd_create), 通过fork继承或SCM_RIGHTS将GetShmFd()传给对端
+    bool CreateMemfd(const char *szName, unsigned int nSize = MAX_SHM_RING_SIZE);
+
+    // 挂载已有共享内存; bConsumer为true时从已提交的读位置继续消费
+    bool Attach(const char *szName, bool bConsumer = true);
+    bool AttachFd(int nFd, bool bConsumer = true);
+
+    void Detach();
+
+    static bool Unlink(const char *szName);
+
+    // 设置唤醒方式, eventfd需要生产者与消费者共享同一个fd
+    void SetNotify(int nNotify, int nEventFd = -1);
+
+    // 写入数据, 空间不足返回false
+    bool Write(const char *pData, unsigned int nLen);
+
+    // 读取下一条记录(不提交), 无数据返回NULL
+    char *Read(unsigned int &nLen);
+
+    // 提交已读取的全部记录, 释放空间给生产者
+    void Commit();
+
+    // 等待数据到达; nTimeoutMs < 0 一直等待
+    bool Wait(int nTimeoutMs);
+
+    bool IsEmpty();
+
+    // 消费者进程是否存活(生产者侧检测)
+    bool IsConsumerAlive();
+
+    float GetUsed(unsigned int &uDrop);
+
+    unsigned int GetAbandoned();
+
+    int GetShmFd() { return m_nShmFd; }
+    int GetEventFd() { return m_nEventFd; }
+
+private:
+    bool Map(int nFd, bool bCreate, unsigned int nSize, bool bConsumer);
+    void Notify();
+
+    ShmRingSlot *ClaimSlot();
+    void ReleaseSlot(ShmRingSlot *pSlot);
+    bool SkipAbandoned();
+
+    ShmRingRecord *RecordAt(uint64_t ullPos)
+    {
+        return (ShmRingRecord *)(m_pData + ullPos % m_nSize);
+    }
+
+    static unsigned int RecordSize(unsigned int nLen)
+    {
+        return (sizeof(ShmRingRecord) + nLen + SHM_RING_ALIGN - 1) & ~(SHM_RING_ALIGN - 1);
+    }
+
+private:
+    CShmRingBuf(const CShmRingBuf &);
+    void operator=(const CShmRingBuf &);
+
+    ShmRingHeader *m_pHeader;
+    char *m_pData;
+    unsigned int m_nSize;
+    size_t m_nMapSize;
+
+    int m_nShmFd;
+    int m_nEventFd;
+    int m_nNotify;
+    bool m_bConsumer;
+
+    uint64_t m_ullReadPos;      // 消费者本地读位置, Commit时写回共享头部
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "ShmRingBuf.h"
+
+#define SHM_NAME    "/shm_ring_test"
+#define LOOP_NUMS   100
+
+
+// 消费nCount条后退出; bCommitLast为false时最后一条不提交, 模拟消费者崩溃
+static int Consume(int nCount, bool bCommitLast)
+{
+    CShmRingBuf ring;
+    if (!ring.Attach(SHM_NAME, true)) {
+        return -1;
+    }
+
+    int nRecv = 0;
+    while (nRecv < nCount) {
+        unsigned int nLen = 0;
+        char *pData = ring.Read(nLen);
+        if (NULL == pData) {
+            ring.Wait(1000);
+            continue;
+        }
+
+        printf("consumer(%d) recv(%u)->%.*s\n", getpid(), nLen, (int)nLen, pData);
+        if (++nRecv < nCount || bCommitLast) {
+            ring.Commit();
+        }
+    }
+
+    fflush(stdout);
+    return 0;
+}
+
+int main()
+{
+    CShmRingBuf ring;
+    if (!ring.Create(SHM_NAME, 4096)) {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (0 == pid) {
+        // 第一个消费者处理一半后退出, 最后一条未提交
+        _exit(Consume(LOOP_NUMS / 2, false));
+    }
+
+    char buf[64];
+    for (int i = 0; i < LOOP_NUMS; ++i) {
+        int nLen = snprintf(buf, sizeof(buf), "Block_%d", i);
+        while (!ring.Write(buf, nLen)) {
+            usleep(1000);
+        }
+    }
+
+    waitpid(pid, NULL, 0);
+    printf("consumer restart, alive:%d\n", ring.IsConsumerAlive());
+
+    pid = fork();
+    if (0 == pid) {
+        // 重新挂载后从已提交位置继续, 未提交的一条会被重新读取
+        _exit(Consume(LOOP_NUMS / 2 + 1, true));
+    }
+    waitpid(pid, NULL, 0);
+
+    unsigned int uDrop = 0;
+    float fUsed = ring.GetUsed(uDrop);
+    printf("used:%.2f drop:%u abandoned:%u\n", fUsed, uDrop, ring.GetAbandoned());
+
+    CShmRingBuf::Unlink(SHM_NAME);
+
+    return 0;
+}
@@ -12,7 +12,8 @@ public:
 
     void init()
     {
-        // 2s定时任务
+        // 2s定时任务, 线程名"offline-0"
+        m_timer_task.set_thread_options(CThreadOptions("offline"));
         m_timer_task.start(std::bind(&ClassTemp::offline_job, this), 2000, false);
     }
 
@@ -26,10 +27,45 @@ private:
     TimerTask m_timer_task;
 };
 
+// 多个定时任务共用定时服务的一个线程
+class ServiceTemp {
+public:
+    explicit ServiceTemp(CTimerService * service) : m_report_task(service), m_service(service) {}
+
+    void init()
+    {
+        m_report_task.start(std::bind(&ServiceTemp::report_job, this), 3000, false);
+
+        // 固定频率: 每秒一次, 不随任务执行时间漂移
+        m_tick_id = m_service->schedule_at_fixed_rate([]() { printf("ServiceTemp tick job\n"); }, 1000);
+        m_service->schedule_once([]() { printf("ServiceTemp once job\n"); }, 1500);
+    }
+
+    ~ServiceTemp()
+    {
+        m_service->cancel(m_tick_id);
+    }
+
+private:
+    void report_job()
+    {
+        printf("ServiceTemp report job\n");
+    }
+
+private:
+    TimerTask m_report_task;
+    CTimerService * m_service;
+    uint64_t m_tick_id = 0;
+};
+
 int main()
 {
     ClassTemp temp;
     temp.init();
+
+    CTimerService service(1, CThreadOptions("timer_service"));
+    ServiceTemp service_temp(&service);
+    service_temp.init();
     
     while (1) {
         sleep(1);
@@ -0,0 +1,223 @@
+#ifndef TIMER_SERVICE_H_
+#define TIMER_SERVICE_H_
+
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <vector>
+#include <unordered_map>
+#include "ThreadUtil.h"
+
+const int TIMER_ONCE = 0;           // 只执行一次
+const int TIMER_FIXED_RATE = 1;     // 按固定频率执行, 下一次时间从上一次的计划时间算起, 不累积误差
+const int TIMER_FIXED_DELAY = 2;    // 上一次执行完后间隔interval_ms再执行
+
+
+// 定时服务: 多个周期/一次性任务共用一个(或几个)线程, 代替每个TimerTask一个线程
+// 同一个任务不会并发执行; 固定频率的任务执行超时错过的周期合并为一次, 之后仍按原来的节拍执行
+class CTimerService
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Job {
+        uint64_t id;
+        int mode;
+        std::chrono::milliseconds interval;
+        std::function<void(void)> task;
+        Clock::time_point due;      // 计划执行时间
+        bool cancelled;
+        bool running;
+        std::thread::id runner;     // 正在执行该任务的线程
+    };
+
+    struct HeapNode {
+        Clock::time_point due;
+        uint64_t id;
+
+        bool operator<(const HeapNode & other) const {
+            return due > other.due;
+        }
+    };
+
+public:
+    explicit CTimerService(const int max_work = 1, const CThreadOptions & opt = CThreadOptions())
+    : m_run(true), m_next_id(0)
+    {
+        int count = max_work > 0 ? max_work : 1;
+        for (int i = 0; i < count; ++i) {
+            m_threads.push_back(std::thread(worker, (void *)this, (size_t)i, opt));
+        }
+    }
+
+    ~CTimerService()
+    {
+        {
+            std::lock_guard<std::mutex> lck(m_mtx);
+            m_run = false;
+        }
+        m_cv.notify_all();
+
+        for (size_t i = 0; i < m_threads.size(); ++i) {
+            m_threads[i].join();
+        }
+    }
+
+    CTimerService(const CTimerService &) = delete;
+    void operator=(const CTimerService &) = delete;
+
+public:
+    // 返回任务id, 用于cancel; immediately为true时第一次立即执行, 否则interval_ms后执行
+    uint64_t schedule(int mode, std::function<void(void)> task, int interval_ms, bool immediately = true)
+    {
+        std::shared_ptr<Job> job = std::make_shared<Job>();
+        job->mode = mode;
+        job->interval = std::chrono::milliseconds(interval_ms > 0 ? interval_ms : 0);
+        job->task = std::move(task);
+        job->due = Clock::now() + (immediately ? std::chrono::milliseconds(0) : job->interval);
+        job->cancelled = false;
+        job->running = false;
+
+        std::lock_guard<std::mutex> lck(m_mtx);
+        job->id = ++m_next_id;
+        m_jobs[job->id] = job;
+        push_locked(job);
+        return job->id;
+    }
+
+    uint64_t schedule_once(std::function<void(void)> task, int delay_ms)
+    {
+        return schedule(TIMER_ONCE, std::move(task), delay_ms, false);
+    }
+
+    uint64_t schedule_at_fixed_rate(std::function<void(void)> task, int interval_ms, bool immediately = true)
+    {
+        return schedule(TIMER_FIXED_RATE, std::move(task), interval_ms, immediately);
+    }
+
+    uint64_t schedule_with_fixed_delay(std::function<void(void)> task, int interval_ms, bool immediately = true)
+    {
+        return schedule(TIMER_FIXED_DELAY, std::move(task), interval_ms, immediately);
+    }
+
+    // 取消后任务不会再执行; 任务正在其他线程执行时等待其结束, 在任务内部取消自己不等待
+    // 返回false表示任务不存在(已取消或一次性任务已执行完)
+    bool cancel(uint64_t id)
+    {
+        std::unique_lock<std::mutex> lck(m_mtx);
+        auto it = m_jobs.find(id);
+        if (it == m_jobs.end()) {
+            return false;
+        }
+
+        std::shared_ptr<Job> job = it->second;
+        job->cancelled = true;
+        m_jobs.erase(it);
+
+        while (job->running && job->runner != std::this_thread::get_id()) {
+            m_done_cv.wait(lck);
+        }
+        return true;
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lck(m_mtx);
+        return m_jobs.size();
+    }
+
+private:
+    static void worker(void * pContext, size_t index, CThreadOptions opt)
+    {
+        CThreadUtil::apply(opt, index);
+        CTimerService * service = (CTimerService *)pContext;
+        service->handle_worker();
+    }
+
+    void handle_worker()
+    {
+        std::unique_lock<std::mutex> lck(m_mtx);
+        while (m_run) {
+            if (m_heap.empty()) {
+                m_cv.wait(lck);
+                continue;
+            }
+
+            HeapNode top = m_heap.top();
+            auto it = m_jobs.find(top.id);
+            if (it == m_jobs.end() || it->second->due != top.due) {
+                m_heap.pop();       // 已取消
+                continue;
+            }
+
+            Clock::time_point now = Clock::now();
+            if (top.due > now) {
+                m_cv.wait_until(lck, top.due);
+                continue;
+            }
+            m_heap.pop();
+
+            std::shared_ptr<Job> job = it->second;
+            job->running = true;
+            job->runner = std::this_thread::get_id();
+            if (!m_heap.empty()) {
+                m_cv.notify_one();  // 其他任务可能也已到期, 交给空闲线程
+            }
+
+            lck.unlock();
+            job->task();
+            lck.lock();
+
+            job->running = false;
+            m_done_cv.notify_all();
+            if (job->cancelled) {
+                continue;
+            }
+
+            now = Clock::now();
+            if (TIMER_ONCE == job->mode) {
+                m_jobs.erase(job->id);
+                continue;
+            } else if (TIMER_FIXED_DELAY == job->mode) {
+                job->due = now + job->interval;
+            } else {
+                job->due += job->interval;
+                if (job->due <= now && job->interval.count() > 0) {
+                    // 错过的周期合并为一次立即执行, 保持原来的节拍
+                    job->due += (now - job->due) / job->interval * job->interval;
+                }
+            }
+            push_locked(job);
+        }
+    }
+
+    void push_locked(const std::shared_ptr<Job> & job)
+    {
+        bool earliest = m_heap.empty() || job->due < m_heap.top().due;
+        HeapNode node;
+        node.due = job->due;
+        node.id = job->id;
+        m_heap.push(node);
+        if (earliest) {
+            m_cv.notify_one();
+        }
+    }
+
+private:
+    bool m_run;
+    uint64_t m_next_id;
+
+    std::mutex m_mtx;
+    std::condition_variable m_cv;       // 有更早到期的任务或退出
+    std::condition_variable m_done_cv;  // 任务执行完, cancel等待使用
+    std::priority_queue<HeapNode> m_heap;
+    std::unordered_map<uint64_t, std::shared_ptr<Job> > m_jobs;
+    std::vector<std::thread> m_threads;
+};
+
+
+#endif /* TIMER_SERVICE_H_ */
@@ -5,11 +5,14 @@
 #include <atomic>
 #include <chrono>
 #include <functional>
+#include "ThreadUtil.h"
+#include "timer_service.h"
 
+// 默认每个TimerTask一个线程; 构造时传入CTimerService则任务在定时服务的线程上执行, 不创建线程
 class TimerTask
 {
 public:
-    TimerTask() : m_execute(false)
+    explicit TimerTask(CTimerService * service = nullptr) : m_execute(false), m_service(service), m_job_id(0)
     {}
 
     ~TimerTask() 
@@ -21,10 +24,20 @@ public:
     void stop() 
     {
         m_execute.store(false, std::memory_order_release);
+        if (m_service && m_job_id > 0) {
+            m_service->cancel(m_job_id);
+            m_job_id = 0;
+        }
         if (m_thd.joinable())
             m_thd.join();
     }
 
+    // 线程名和CPU/NUMA绑定, 在start前设置; 使用定时服务时无效
+    void set_thread_options(const CThreadOptions & opt)
+    {
+        m_opt = opt;
+    }
+
     // template task
     template<typename FUNC>
     void start(FUNC task, int interval_ms, bool immediately = true) 
@@ -33,7 +46,13 @@ public:
             stop();
         }
         m_execute.store(true, std::memory_order_release);
+        if (m_service) {
+            // 与独立线程的语义一致: 执行完后间隔interval_ms
+            m_job_id = m_service->schedule_with_fixed_delay(task, interval_ms, immediately);
+            return;
+        }
         m_thd = std::thread([this, task, interval_ms, immediately]() {
+            CThreadUtil::apply(m_opt, 0);
             while (m_execute.load(std::memory_order_acquire)) {
                 if (immediately) {
                     task();
@@ -49,12 +68,15 @@ public:
     bool is_running() const noexcept 
     {
         return (m_execute.load(std::memory_order_acquire) &&
-                m_thd.joinable());
+                (m_thd.joinable() || m_job_id > 0));
     }
 
 private:
     std::atomic<bool> m_execute;
     std::thread m_thd;
+    CThreadOptions m_opt;
+    CTimerService * m_service;
+    uint64_t m_job_id;
 };
 
 #endif